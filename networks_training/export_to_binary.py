@@ -0,0 +1,55 @@
+# export_to_binary.py
+# Turns the trainer's raw export (indus_dragon_v3.bin) into a net file the
+# engine loads at runtime with `setoption name EvalFile value <file>` or
+# `--evalfile <file>`, no rebuild needed.
+#
+# usage: python export_to_binary.py [input=indus_dragon_v3.bin] [output=indus_dragon_v3.nnue]
+#
+# Layout (all little-endian, see NetFileHeader in src/nnue.hpp):
+#   64-byte header: magic "INDUSNN\0", version, architecture, input size,
+#                   hidden size, scale, CRC-32 of the payload, payload bytes
+#   payload:        feature weights [768][256] (already transposed to the
+#                   order the engine reads), 256 hidden biases,
+#                   256 output weights, 1 output bias, all int16
+import struct
+import sys
+import zlib
+
+import numpy as np
+
+INPUT_FEATURES = 768
+HIDDEN_SIZE = 256
+SCALE = 255
+NET_FILE_VERSION = 1
+ARCHITECTURE = 1  # 768 -> 256 ReLU -> 1
+
+src = sys.argv[1] if len(sys.argv) > 1 else "indus_dragon_v3.bin"
+dst = sys.argv[2] if len(sys.argv) > 2 else "indus_dragon_v3.nnue"
+
+data = np.fromfile(src, dtype="<i2")
+expected = HIDDEN_SIZE * INPUT_FEATURES + HIDDEN_SIZE + HIDDEN_SIZE + 1
+if data.size != expected:
+    sys.exit(f"{src}: expected {expected} int16 values, found {data.size}")
+
+# The trainer writes one row of 768 inputs per hidden neuron
+weights = data[: HIDDEN_SIZE * INPUT_FEATURES].reshape(HIDDEN_SIZE, INPUT_FEATURES).T
+payload = np.concatenate([weights.ravel(), data[HIDDEN_SIZE * INPUT_FEATURES :]])
+payload = payload.astype("<i2").tobytes()
+
+header = struct.pack(
+    "<8s6IQ24x",
+    b"INDUSNN\0",
+    NET_FILE_VERSION,
+    ARCHITECTURE,
+    INPUT_FEATURES,
+    HIDDEN_SIZE,
+    SCALE,
+    zlib.crc32(payload),
+    len(payload),
+)
+
+with open(dst, "wb") as f:
+    f.write(header)
+    f.write(payload)
+
+print(f"wrote {dst}: {len(header) + len(payload)} bytes")
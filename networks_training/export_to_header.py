@@ -1,14 +1,26 @@
 # embed_nnue.py
+# Writes src/nnue_data.hpp from the trainer's raw export. The feature
+# weights are transposed here, to the [feature][hidden] order the engine's
+# kernels read, so the engine uses the array in place with no load step.
 import numpy as np
 
+INPUT_FEATURES = 768
+HIDDEN_SIZE = 256
+
 data = np.fromfile("indus_dragon_v3.bin", dtype=np.int16)
 
+# The trainer writes one row of 768 inputs per hidden neuron
+weights = data[: HIDDEN_SIZE * INPUT_FEATURES].reshape(HIDDEN_SIZE, INPUT_FEATURES).T
+data = np.concatenate([weights.ravel(), data[HIDDEN_SIZE * INPUT_FEATURES :]])
+
 with open("nnue_data.hpp", "w") as f:
     f.write("#pragma once\n\n")
     f.write("#include <cstdint>\n\n")
-    f.write("constexpr int16_t NNUE_DATA[] = {\n")
+    f.write("// Feature weights [768][256], hidden biases [256], output weights [256],\n")
+    f.write("// output bias. Generated by networks_training/export_to_header.py.\n")
+    f.write("alignas(64) constexpr int16_t NNUE_DATA[] = {\n")
     for i, val in enumerate(data):
         f.write(f"{val}, ")
         if (i + 1) % 16 == 0:
             f.write("\n")
-    f.write("};\n")
\ No newline at end of file
+    f.write("};\n")
@@ -9,6 +9,15 @@ constexpr int DRAW_SCORE = 0;
 // MAX search depth
 constexpr int MAX_SEARCH_DEPTH = 100;
 
+// Upper bound for the Threads UCI option (main thread + Lazy SMP helpers)
+constexpr int MAX_THREADS = 256;
+
+// Upper bound for the Hash UCI option, in MB
+constexpr int MAX_HASH_MB = 65536;
+
+// Upper bound for the MultiPV UCI option (no position has more legal moves)
+constexpr int MAX_MULTIPV = 256;
+
 // Piece values in centipawns
 constexpr int PAWN_VALUE = 100;
 constexpr int KNIGHT_VALUE = 300;
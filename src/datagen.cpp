@@ -62,7 +62,7 @@ void playOneGame(chess::Board &board, TranspositionTable &tt, Search &search,
                   double &outWhiteResult) {
   outPositions.clear();
   board = chess::Board();
-  tt.clear_table();
+  tt.newSearch();
 
   if (!playRandomOpening(board, opts.randomPlies, rng)) {
     outWhiteResult = -1.0;
@@ -73,6 +73,11 @@ void playOneGame(chess::Board &board, TranspositionTable &tt, Search &search,
   int blackStreak = 0;
   std::uniform_real_distribution<double> noiseChance(0.0, 1.0);
 
+  GoOptions limits;
+  limits.softNodes = opts.softNodes;
+  limits.nodes = opts.hardNodes;
+  const bool nodeLimited = opts.softNodes > 0 || opts.hardNodes > 0;
+
   for (int ply = 0; ply < opts.maxGameLength; ++ply) {
     if (board.isGameOver().second != chess::GameResult::NONE) {
       outWhiteResult = resultFromGameOver(board);
@@ -80,7 +85,8 @@ void playOneGame(chess::Board &board, TranspositionTable &tt, Search &search,
     }
 
     search.setSilent(true);
-    search.searchBestMove(opts.searchDepth);
+    search.setTimeValues(limits);
+    search.searchBestMove(nodeLimited ? 0 : opts.searchDepth);
     const chess::Move bestMove = search.getLastBestMove();
     const int score = search.getLastScore();
 
@@ -145,10 +151,9 @@ uint64_t deriveThreadSeed(uint64_t baseSeed, unsigned int threadIndex) {
   return z ^ (z >> 31);
 }
 
-// Per-thread worker state, all constructed sequentially on the main thread
-// before any thread starts running — Search's constructor loads the NNUE
-// network into global arrays, so no two Search objects may ever be
-// constructed concurrently.
+// Per-thread worker state, all constructed on the main thread before any
+// thread starts running. Every worker's Search reads the one shared,
+// read-only NNUE network, so constructing one costs no network loading.
 struct WorkerContext {
   chess::Board board;
   TranspositionTable tt;
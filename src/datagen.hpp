@@ -14,6 +14,13 @@ struct DatagenOptions {
   // per-move strength. Depth 6-8 is the usual sweet spot for hobby engines.
   int searchDepth = 7;
 
+  // Node-limited alternative to searchDepth; when either is set the depth
+  // is ignored. No new iteration starts past softNodes, and hardNodes
+  // aborts the iteration in progress. Unlike depth, a node budget costs
+  // the same on every machine, so throughput and labels are reproducible.
+  long long softNodes = 0;
+  long long hardNodes = 0;
+
   // Random legal moves played from the startpos before search-driven play
   // begins, to diversify the opening distribution instead of always
   // reaching the same handful of well-known lines.
@@ -60,8 +67,9 @@ struct DatagenOptions {
   // Print a progress line every N completed games.
   long long progressEvery = 50;
 
-  // Small transposition table per game keeps datagen fast without needing a
-  // large hash allocation; it's cleared between games for a clean slate.
+  // Small transposition table per worker keeps datagen fast without needing
+  // a large hash allocation. Each game starts a new TT generation instead of
+  // clearing it, so the previous game's entries are the first to go.
   size_t ttMegabytes = 8;
 
   unsigned int numThreads = 1;
@@ -1,14 +1,38 @@
 #include "engine.hpp"
 
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <random>
+#include <vector>
+
 Engine::Engine() : board(), tt_helper(), search(board, tt_helper) {}
 
+Engine::~Engine() { stopSearch(); }
+
+// A `stop` with no search running still sets the request; it is cleared
+// here so it can't abort the next search the moment it starts.
+void Engine::stopSearch() {
+  if (!searchThread.joinable()) {
+    search.resetStop();
+    return;
+  }
+
+  search.stopSearch();
+  searchThread.join();
+  search.resetStop();
+}
+
 void Engine::printBoard() { std::cout << board << "\n" << board.getFen(); }
 
 void Engine::setPosition(const std::string &fen) { board.setFen(fen); }
 
+// ucinewgame: the old game's entries are aged rather than wiped, which is
+// O(1) whatever the Hash size. `setoption name Clear Hash` really clears.
 void Engine::initializeEngine() {
   board = chess::Board();
-  tt_helper.clear_table();
+  tt_helper.newSearch();
 }
 
 void Engine::makeMove(std::string move) {
@@ -35,37 +59,123 @@ GoOptions parseGoOptions(std::istringstream& iss) {
       iss >> options.movestogo;
     } else if (token == "movetime") {
       iss >> options.movetime;
+    } else if (token == "ponder") {
+      options.ponder = true;
     } else if (token == "depth"){
       iss >> options.depth;
+    } else if (token == "nodes") {
+      iss >> options.nodes;
     }
   }
 
   return options;
 }
 
-void Engine::handleBench() {
-  const int benchDepth = 8; // fixed depth, not time-limited
+/*
+bench [depth N | nodes N]: fixed work per position, never time-limited,
+so the node count is a reproducible signature of the search. The default
+is depth 8; `nodes N` deepens until N nodes have been searched instead.
+*/
+void Engine::handleBench(std::istringstream &iss) {
+  std::string mode;
+  iss >> mode;
+  if (mode == "smp") {
+    handleBenchSmp();
+    return;
+  }
+
+  int benchDepth = 8;
+  GoOptions limits;  // no time limit
+  long long value = 0;
+  if (mode == "depth" && iss >> value && value > 0) {
+    benchDepth = static_cast<int>(std::min<long long>(value, MAX_SEARCH_DEPTH));
+  } else if (mode == "nodes" && iss >> value && value > 0) {
+    benchDepth = MAX_SEARCH_DEPTH;
+    limits.nodes = value;
+  }
+
+  // Start cold so repeated runs in one session give the same node counts.
+  tt_helper.clear_table();
+
   long long totalNodes = 0;
+  long long accQueued = 0, accApplied = 0;
+  SearchStats benchStats;
   auto start = std::chrono::steady_clock::now();
 
   for (const auto& fen : BENCH_POSITIONS) {
     board.setFen(fen);
-    search.setTimeValues(GoOptions{}); // infinite/no time limit — depth-limited only
-    // (needs a depth-limited entry point into Search — see note below)
+    search.setTimeValues(limits);
     totalNodes += search.benchSearch(benchDepth);
+    benchStats.add(search.getStats());
+    accQueued += search.getAccUpdatesQueued();
+    accApplied += search.getAccUpdatesApplied();
   }
 
   auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
       std::chrono::steady_clock::now() - start).count();
   long long nps = elapsed > 0 ? (totalNodes * 1000) / elapsed : 0;
 
+  if (SEARCH_STATS_ENABLED) {
+    benchStats.dump(std::cout);
+  }
+
+  const double avoided = accQueued > 0 ? 100.0 * (accQueued - accApplied) / accQueued : 0.0;
+  std::cout << "accumulator updates " << accQueued << " applied " << accApplied << " avoided "
+            << std::fixed << std::setprecision(1) << avoided << "%" << std::defaultfloat << "\n";
   std::cout << totalNodes << " nodes " << nps << " nps\n";
 }
 
+/*
+Lazy SMP scaling check: time-to-depth over the bench positions at
+1/2/4/8/16 threads. The TT is cleared before every thread count so each
+run starts cold, and the configured Threads value is restored afterwards.
+*/
+void Engine::handleBenchSmp() {
+  const int benchDepth = 8;
+  static constexpr int THREAD_COUNTS[] = {1, 2, 4, 8, 16};
+
+  const int configuredThreads = search.getThreads();
+  long long singleThreadTime = 0;
+
+  search.setSilent(true);
+
+  for (int threads : THREAD_COUNTS) {
+    search.setThreads(threads);
+    tt_helper.clear_table();
+
+    long long totalNodes = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (const auto& fen : BENCH_POSITIONS) {
+      board.setFen(fen);
+      search.setTimeValues(GoOptions{});
+      search.searchBestMove(benchDepth);
+      totalNodes += search.getLastNodes();
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    if (threads == 1) singleThreadTime = elapsed;
+
+    long long nps = elapsed > 0 ? (totalNodes * 1000) / elapsed : 0;
+    double speedup = elapsed > 0 ? static_cast<double>(singleThreadTime) / elapsed : 0.0;
+
+    std::cout << "threads " << threads << " depth " << benchDepth << " time "
+              << elapsed << " ms nodes " << totalNodes << " nps " << nps
+              << " speedup " << std::fixed << std::setprecision(2) << speedup
+              << std::defaultfloat << "\n";
+  }
+
+  search.setSilent(false);
+  search.setThreads(configuredThreads);
+}
+
 void Engine::handleGo(std::istringstream& iss) {
   GoOptions options = parseGoOptions(iss);
+  stopSearch();
+  search.resetStop();
   search.setTimeValues(options);
-  search.searchBestMove(options.depth);
+  searchThread = std::thread([this, depth = options.depth] { search.searchBestMove(depth); });
 }
 
 
@@ -74,7 +184,7 @@ void Engine::handleFen(std::istringstream &iss) {
   iss >> token;
 
   if (token == "startpos") {
-    initializeEngine();
+    board = chess::Board();
 
     // Process any moves that come after "startpos moves"
     if (iss >> token && token == "moves") {
@@ -125,29 +235,291 @@ void Engine::handleSetOption(std::istringstream &iss) {
   if (name == "Hash") {
     try {
       int mb = std::stoi(value);
-      mb = std::max(1, std::min(1024, mb));
-      tt_helper.resize(static_cast<size_t>(mb));
+      mb = std::max(1, std::min(MAX_HASH_MB, mb));
+      if (!tt_helper.resize(static_cast<size_t>(mb))) {
+        sendLine("info string could not allocate " + std::to_string(mb) + " MB of Hash");
+      }
+      printHashInfo();
+    } catch (...) {
+      // malformed value, ignore
+    }
+  } else if (name == "EvalFile") {
+    loadEvalFile(value);
+  } else if (name == "NNUEKernels") {
+    if (!NNUE::selectKernels(value)) {
+      sendLine("info string NNUE kernels " + value + " not available on this CPU");
+    }
+    printKernelInfo();
+  } else if (name == "Clear Hash") {
+    tt_helper.clear_table();
+  } else if (name == "QSearchChecks") {
+    search.setQsearchChecks(value == "true");
+  } else if (name == "MultiPV") {
+    try {
+      int lines = std::stoi(value);
+      lines = std::max(1, std::min(MAX_MULTIPV, lines));
+      search.setMultiPV(lines);
+    } catch (...) {
+      // malformed value, ignore
+    }
+  } else if (name == "Threads") {
+    try {
+      int threads = std::stoi(value);
+      threads = std::max(1, std::min(MAX_THREADS, threads));
+      search.setThreads(threads);
     } catch (...) {
       // malformed value, ignore
     }
   }
 }
 
+/*
+ttstress [threads] [ops]: threads hammering stores and probes on a 1 MB
+table at once. Every key k has exactly one move, score and depth, and k
+is also the low 16 bits of its hash, so two keys never share an entry
+key. A probe that returns anything but k's own data has read a torn or
+mixed entry.
+*/
+void Engine::handleTTStress(std::istringstream &iss) {
+  int threads = 8;
+  long long opsPerThread = 1000000;
+  iss >> threads >> opsPerThread;
+  threads = std::max(1, std::min(MAX_THREADS, threads));
+
+  TranspositionTable table(1);
+
+  auto hashOf = [](uint32_t k) {
+    uint64_t x = (k + 1) * 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return (x & ~0xFFFFULL) | k;
+  };
+  auto moveOf = [](uint32_t k) { return chess::Move(static_cast<uint16_t>(k * 7919u + 1)); };
+  auto scoreOf = [](uint32_t k) { return static_cast<int>(k % 3001) - 1500; };
+  auto depthOf = [](uint32_t k) { return 1 + static_cast<int>(k % 60); };
+
+  std::atomic<long long> probes{0}, hits{0}, corrupt{0};
+  std::vector<std::thread> workers;
+
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      std::mt19937 rng(12345 + t);
+      long long localProbes = 0, localHits = 0, localCorrupt = 0;
+
+      for (long long i = 0; i < opsPerThread; ++i) {
+        const uint32_t k = rng() & 0xFFFF;
+        const uint64_t hash = hashOf(k);
+
+        if (rng() & 1) {
+          table.storeTT(hash, depthOf(k), scoreOf(k), TTEntryType::EXACT, moveOf(k), 0);
+          continue;
+        }
+
+        int score = 0;
+        chess::Move move = chess::Move::NULL_MOVE;
+        const bool found = table.probeTT(hash, 0, score, -MATE_SCORE, MATE_SCORE, move, 0);
+        localProbes++;
+        if (found) {
+          localHits++;
+          if (move != moveOf(k) || score != scoreOf(k)) localCorrupt++;
+        } else if (move != chess::Move::NULL_MOVE) {
+          localCorrupt++;  // every stored entry is EXACT, so a match must cut
+        }
+      }
+
+      probes += localProbes;
+      hits += localHits;
+      corrupt += localCorrupt;
+    });
+  }
+
+  for (auto &worker : workers) worker.join();
+
+  sendLine("ttstress threads " + std::to_string(threads) + " probes " +
+           std::to_string(probes) + " hits " + std::to_string(hits) + " corrupt " +
+           std::to_string(corrupt) + (corrupt == 0 ? " ok" : " FAILED"));
+}
+
+/*
+evalcheck [full]: the integer cp mapping against the float reference it
+replaced. Every output sum in [-2^22, 2^22] is compared (both saturate
+near +-600000) plus every 4099th value over the rest of int32; `full`
+compares all 2^32 sums, which takes about a minute.
+*/
+void Engine::handleEvalCheck(std::istringstream &iss) {
+  std::string mode;
+  iss >> mode;
+
+  long long checked = 0, offByOne = 0;
+  int maxDiff = 0;
+  int64_t worstSum = 0;
+  auto check = [&](int64_t sum) {
+    const int32_t s = static_cast<int32_t>(sum);
+    const int diff = std::abs(NNUE::Network::sumToCp(s) - NNUE::Network::sumToCpFloat(s));
+    checked++;
+    if (diff == 1) offByOne++;
+    if (diff > maxDiff) {
+      maxDiff = diff;
+      worstSum = sum;
+    }
+  };
+
+  if (mode == "full") {
+    for (int64_t sum = INT32_MIN; sum <= INT32_MAX; ++sum) check(sum);
+  } else {
+    for (int64_t sum = -(1 << 22); sum <= (1 << 22); ++sum) check(sum);
+    for (int64_t sum = INT32_MIN; sum <= INT32_MAX; sum += 4099) check(sum);
+  }
+
+  std::cout << "evalcheck sums " << checked << " off by one " << offByOne << " max diff "
+            << maxDiff << " at " << worstSum << (maxDiff <= 1 ? " ok" : " FAILED") << std::endl;
+}
+
+/*
+evalbench [calls]: nanoseconds per Network::evaluate() on the bench
+positions, and for the cp mapping alone, integer vs float reference.
+*/
+void Engine::handleEvalBench(std::istringstream &iss) {
+  long long calls = 2000000;
+  iss >> calls;
+  calls = std::max(1LL, calls);
+
+  const NNUE::Network &net = NNUE::network();
+
+  std::vector<NNUE::Accumulator> accs(BENCH_POSITIONS.size());
+  std::vector<chess::Color> sides;
+  for (size_t i = 0; i < BENCH_POSITIONS.size(); ++i) {
+    chess::Board position(BENCH_POSITIONS[i]);
+    net.refreshAccumulator(position, accs[i]);
+    sides.push_back(position.sideToMove());
+  }
+
+  // Output sums spread over the range where the mapping is not saturated.
+  std::vector<int32_t> sums(4096);
+  std::mt19937 rng(1);
+  for (auto &sum : sums) sum = static_cast<int32_t>(rng() % 1400001) - 700000;
+
+  auto nsPerCall = [calls](auto &&body) {
+    long long sink = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (long long i = 0; i < calls; ++i) sink += body(i);
+    const auto elapsed = std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count();
+    volatile long long keep = sink;
+    (void)keep;
+    return elapsed / calls;
+  };
+
+  const double evalNs = nsPerCall([&](long long i) {
+    const size_t p = i % accs.size();
+    return net.evaluate(sides[p], accs[p]);
+  });
+  const double intNs = nsPerCall([&](long long i) {
+    return NNUE::Network::sumToCp(sums[i & (sums.size() - 1)]);
+  });
+  const double floatNs = nsPerCall([&](long long i) {
+    return NNUE::Network::sumToCpFloat(sums[i & (sums.size() - 1)]);
+  });
+
+  std::cout << std::fixed << std::setprecision(2) << "evalbench kernels " << NNUE::kernelName()
+            << " evaluate " << evalNs << " ns, cp mapping int " << intNs << " ns float "
+            << floatNs << " ns" << std::defaultfloat << std::endl;
+}
+
+void Engine::handleHashFile(const std::string &command, std::istringstream &iss) {
+  std::string path;
+  std::getline(iss >> std::ws, path);
+  if (path.empty()) {
+    sendLine("info string usage: " + command + " <file>");
+    return;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  std::string error;
+  const bool ok = command == "savehash" ? tt_helper.save(path, error)
+                                        : tt_helper.load(path, error);
+  const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+
+  if (!ok) {
+    sendLine("info string " + command + " failed: " + error);
+    return;
+  }
+
+  sendLine("info string " + command + " " + path + " done in " + std::to_string(elapsed) +
+           " ms");
+  if (command == "loadhash") printHashInfo();
+}
+
+void Engine::printHashInfo() {
+  sendLine("info string Hash " + std::to_string(tt_helper.sizeMB()) + " MB, " +
+           tt_helper.allocationMode());
+}
+
+// An empty value or "<embedded>" goes back to the net built into the binary.
+bool Engine::loadEvalFile(const std::string &path) {
+  const auto start = std::chrono::steady_clock::now();
+  std::string error;
+  bool ok = true;
+  if (path.empty() || path == "<embedded>") {
+    NNUE::loadEmbeddedNetwork();
+  } else {
+    ok = NNUE::loadNetworkFile(path, error);
+  }
+  const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start).count();
+
+  if (!ok) {
+    sendLine("info string EvalFile " + path + ": " + error + ", keeping " + NNUE::networkName());
+    return false;
+  }
+  std::ostringstream msg;
+  msg << "info string NNUE network " << NNUE::networkName() << " loaded in " << std::fixed
+      << std::setprecision(1) << elapsed / 1000.0 << " ms";
+  sendLine(msg.str());
+  return true;
+}
+
+void Engine::printKernelInfo() {
+  sendLine(std::string("info string NNUE kernels ") + NNUE::kernelName());
+}
+
+// Counters of the last `go` (or of the last bench position).
+void Engine::handleSearchStats() {
+  if (!SEARCH_STATS_ENABLED) {
+    std::cout << "info string search statistics are not compiled in, "
+                 "rebuild with -DINDUS_ENABLE_SEARCH_STATS=ON"
+              << std::endl;
+    return;
+  }
+
+  const SearchStats stats = search.getStats();
+  stats.print(std::cout);
+  stats.dump(std::cout);
+  std::cout << std::flush;
+}
 
 void Engine::uciLoop() {
   /*
-  This loop will be in action while there is no search ongoing.
-  When we are given a go command we call the search on the same thread.
-  Search itself is responsible for handling the rest of commands that might
-  occur during search like stop, quit.
-  Therefore in ideal conditions stopsearch will never need to be called from
-  here.
+  This thread only reads and answers UCI input; `go` hands the search to
+  searchThread and returns straight away. That keeps `stop` and `isready`
+  instant during a search, and the search never has to poll stdin.
+  Anything that changes engine state (position, options, the TT) first
+  stops and joins a running search, so nothing is modified underneath it.
   */
  std::cout << "Extended Commands for debugging\n";
  std::cout << "'d' - print the current board\n";
  std::cout << "'togglelogs' - Write the engine logs to a log file for debug\n";
- std::cout << "'ttstats' - Print TTHits and Stores\n";
+ std::cout << "'ttstats' - Print TT occupancy (and hits and stores in stats builds)\n";
  std::cout << "'bench' - run fixed-depth benchmark for regression testing\n";
+ std::cout << "'bench depth N' / 'bench nodes N' - bench with a custom depth or node budget\n";
+ std::cout << "'bench smp' - time-to-depth scaling at 1/2/4/8/16 threads\n";
+ std::cout << "'searchstats' - Print search counters for the last search\n";
+ std::cout << "'ttstress [threads] [ops]' - concurrent store/probe check of the TT\n";
+ std::cout << "'savehash <file>' / 'loadhash <file>' - write the TT to disk / read it back\n";
+ std::cout << "'evalcheck [full]' - integer eval mapping vs the float reference\n";
+ std::cout << "'evalbench [calls]' - time evaluate() and the cp mapping\n";
 
   std::string cmd;
 
@@ -160,39 +532,78 @@ void Engine::uciLoop() {
     if (token == "uci") {
       std::string idName = "id name Indus Dragon";
       std::string idAuthor = "id author Razamindset";
-      std::cout << "option name Hash type spin default 16 min 1 max 1024" << std::endl;
+      sendLine("option name Hash type spin default 16 min 1 max " + std::to_string(MAX_HASH_MB));
+      sendLine("option name Threads type spin default 1 min 1 max " + std::to_string(MAX_THREADS));
+      sendLine("option name QSearchChecks type check default false");
+      sendLine("option name Clear Hash type button");
+      sendLine("option name Ponder type check default false");
+      sendLine("option name MultiPV type spin default 1 min 1 max " + std::to_string(MAX_MULTIPV));
+      sendLine("option name EvalFile type string default <embedded>");
+      sendLine("option name NNUEKernels type combo default auto var auto var scalar var sse4.1 "
+               "var avx2 var avx512bw");
 
       std::string uciOk = "uciok";
 
-      std::cout << idName << std::endl;
-      std::cout << idAuthor << std::endl;
+      sendLine(idName);
+      sendLine(idAuthor);
+      printHashInfo();
+      printKernelInfo();
 
-      std::cout << uciOk << std::endl;
-      fflush(stdout);
+      sendLine(uciOk);
 
     } else if (token == "isready") {
-      std::string readyOk = "readyok";
-      std::cout << readyOk << std::endl;
-      fflush(stdout);
+      sendLine("readyok");
 
+    } else if (token == "stop") {
+      search.stopSearch();
+    } else if (token == "ponderhit") {
+      search.ponderhit();
     } else if (token == "position") {
+      stopSearch();
       handleFen(iss);
     } else if (token == "d") {
+      stopSearch();
       printBoard();
     } else if (token == "quit") {
-      exit(0);
+      break;
     } else if (token == "ucinewgame") {
+      stopSearch();
       initializeEngine();
     } else if (token == "bench") {
-      handleBench();
+      stopSearch();
+      handleBench(iss);
     } else if (token == "togglelogs") {
       search.toggleLogs();
     } else if (token == "ttstats") {
-      tt_helper.printTTStats();
+      // May run during a search: built first, then sent as one block so
+      // the search's info lines can't land in the middle of it.
+      std::ostringstream out;
+      tt_helper.printTTStats(out);
+      std::string text = out.str();
+      if (!text.empty() && text.back() == '\n') text.pop_back();
+      sendLine(text);
+    } else if (token == "savehash" || token == "loadhash") {
+      stopSearch();
+      handleHashFile(token, iss);
+    } else if (token == "ttstress") {
+      stopSearch();
+      handleTTStress(iss);
+    } else if (token == "evalcheck") {
+      stopSearch();
+      handleEvalCheck(iss);
+    } else if (token == "evalbench") {
+      stopSearch();
+      handleEvalBench(iss);
+    } else if (token == "searchstats") {
+      stopSearch();
+      handleSearchStats();
     } else if (token == "go") {
       handleGo(iss);
     } else if (token == "setoption") {
+      stopSearch();
       handleSetOption(iss);
     }
   }
+
+  stopSearch();
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <thread>
 
 #include "chess.hpp"
 #include "constants.hpp"
@@ -12,6 +13,7 @@
 class Engine {
  public:
   Engine();
+  ~Engine();
   void setPosition(const std::string &fen);
 
   void printBoard();
@@ -26,12 +28,39 @@ class Engine {
 
   void handleFen(std::istringstream &iss);
 
-  void handleBench();
+  void handleBench(std::istringstream &iss);
+
+  void handleBenchSmp();
+
+  void handleSearchStats();
+
+  void printHashInfo();
+
+  void printKernelInfo();
+
+  // Switch the process-wide NNUE to a net file; false (and an info string)
+  // if it can't be used.
+  bool loadEvalFile(const std::string &path);
+
+  void handleTTStress(std::istringstream &iss);
+
+  void handleEvalCheck(std::istringstream &iss);
+
+  void handleEvalBench(std::istringstream &iss);
+
+  // savehash / loadhash <file>
+  void handleHashFile(const std::string &command, std::istringstream &iss);
 
   void handleSetOption(std::istringstream &iss);
-  
+
+  // Stop a running search (if any) and wait for its bestmove.
+  void stopSearch();
+
  private:
   chess::Board board;
   TranspositionTable tt_helper;
   Search search;
+
+  // `go` runs here so the UCI loop keeps reading input during a search.
+  std::thread searchThread;
 };
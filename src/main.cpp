@@ -1,11 +1,14 @@
 #include <cstdlib>
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include "datagen.hpp"
 #include "engine.hpp"
 
 // Usage: indus-dragon datagen <output_file> [num_games=1000] [depth=7] [seed=0] [threads=1]
+//                             [append=0] [soft_nodes=0] [hard_nodes=0]
+// Nonzero node limits replace the fixed depth.
 static int runDatagen(int argc, char **argv) {
   Datagen::DatagenOptions opts;
 
@@ -15,10 +18,14 @@ static int runDatagen(int argc, char **argv) {
   if (argc > 5) opts.seed = static_cast<uint64_t>(std::atoll(argv[5]));
   if (argc > 6) opts.numThreads = static_cast<unsigned int>(std::atoi(argv[6]));
   if (argc > 7) opts.appendOutput = (std::atoi(argv[7]) != 0);
+  if (argc > 8) opts.softNodes = std::atoll(argv[8]);
+  if (argc > 9) opts.hardNodes = std::atoll(argv[9]);
 
   std::cout << "[datagen] output=" << opts.outputPath
             << " games=" << opts.numGames
             << " depth=" << opts.searchDepth
+            << " soft_nodes=" << opts.softNodes
+            << " hard_nodes=" << opts.hardNodes
             << " seed=" << opts.seed
             << " threads=" << opts.numThreads << std::endl;
 
@@ -26,7 +33,29 @@ static int runDatagen(int argc, char **argv) {
   return 0;
 }
 
+// `--evalfile <file>` may come anywhere on the command line, for UCI and
+// datagen alike, and is taken out before the other arguments are read.
 int main(int argc, char **argv) {
+  std::vector<char *> args;
+  std::string evalFile;
+  for (int i = 0; i < argc; ++i) {
+    if (std::string(argv[i]) == "--evalfile" && i + 1 < argc) {
+      evalFile = argv[++i];
+    } else {
+      args.push_back(argv[i]);
+    }
+  }
+  argc = static_cast<int>(args.size());
+  argv = args.data();
+
+  if (!evalFile.empty()) {
+    std::string error;
+    if (!NNUE::loadNetworkFile(evalFile, error)) {
+      std::cerr << "--evalfile " << evalFile << ": " << error << std::endl;
+      return 1;
+    }
+  }
+
   if (argc > 1 && std::string(argv[1]) == "datagen") {
     return runDatagen(argc, argv);
   }
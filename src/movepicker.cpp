@@ -0,0 +1,392 @@
+#include "movepicker.hpp"
+
+#include <algorithm>
+
+#include "constants.hpp"
+#include "search.hpp"
+
+namespace {
+
+// Pawns one push away from promoting, per side (rank 7 for white, rank 2 for black).
+constexpr uint64_t PROMOTION_RANK[2] = {0x00FF000000000000ULL, 0x000000000000FF00ULL};
+
+bool isQueenPromotion(chess::Move move) {
+  return move.typeOf() == chess::Move::PROMOTION && move.promotionType() == chess::PieceType::QUEEN;
+}
+
+}  // namespace
+
+MovePicker::MovePicker(Search &search, chess::Move ttMove, int ply, bool isQuiescence,
+                       bool quietChecks)
+    : search(search),
+      board(search.board),
+      stage(Stage::TT_MOVE),
+      isQuiescence(isQuiescence),
+      quietChecks(quietChecks),
+      ttMove(ttMove),
+      killer1(search.killerMoves[ply][0]),
+      killer2(search.killerMoves[ply][1]) {
+  if (ttMove == chess::Move::NULL_MOVE || ttMove == chess::Move::NO_MOVE) {
+    stage = board.inCheck() ? Stage::GEN_EVASIONS : Stage::GEN_CAPTURES;
+  }
+}
+
+chess::Move MovePicker::next() {
+  using chess::Move;
+  using chess::movegen;
+
+  while (true) {
+    switch (stage) {
+      case Stage::TT_MOVE: {
+        const bool inCheck = board.inCheck();
+        stage = inCheck ? Stage::GEN_EVASIONS : Stage::GEN_CAPTURES;
+
+        // The TT move comes from a different position whenever the hash
+        // collides, so it has to be verified before it's played.
+        if (isLegal(ttMove) && (inCheck || !isQuiescence || isTacticalMove(ttMove))) {
+          return ttMove;
+        }
+        ttMove = Move::NULL_MOVE;
+        break;
+      }
+
+      case Stage::GEN_CAPTURES:
+        movegen::legalmoves<movegen::MoveGenType::CAPTURE>(moves, board);
+        search.countMoveGen();
+        addQueenPromotions();
+        scoreCaptures();
+        index = 0;
+        stage = Stage::GOOD_CAPTURES;
+        break;
+
+      case Stage::GOOD_CAPTURES:
+        while (index < moves.size()) {
+          const Move move = pickBest();
+          if (move == ttMove) continue;
+
+          // Losing captures wait until after the quiets. In qsearch they
+          // are dropped outright: stand-pat already covers "don't capture".
+          if (board.isCapture(move) && search.see(move) < 0) {
+            if (!isQuiescence) badCaptures.add(move);
+            continue;
+          }
+          return move;
+        }
+        if (isQuiescence) {
+          stage = quietChecks ? Stage::GEN_QUIET_CHECKS : Stage::DONE;
+        } else {
+          stage = Stage::KILLER_1;
+        }
+        break;
+
+      case Stage::KILLER_1:
+        stage = Stage::KILLER_2;
+        if (killer1 != ttMove && !isTacticalMove(killer1) && isLegal(killer1)) {
+          return killer1;
+        }
+        break;
+
+      case Stage::KILLER_2:
+        stage = Stage::GEN_QUIETS;
+        if (killer2 != ttMove && killer2 != killer1 && !isTacticalMove(killer2) &&
+            isLegal(killer2)) {
+          return killer2;
+        }
+        break;
+
+      case Stage::GEN_QUIETS:
+        movegen::legalmoves<movegen::MoveGenType::QUIET>(moves, board);
+        search.countMoveGen();
+        scoreQuiets();
+        index = 0;
+        stage = Stage::QUIETS;
+        break;
+
+      case Stage::QUIETS:
+        while (index < moves.size()) {
+          const Move move = pickBest();
+          if (move == ttMove || move == killer1 || move == killer2 || isQueenPromotion(move)) {
+            continue;
+          }
+          return move;
+        }
+        stage = Stage::BAD_CAPTURES;
+        break;
+
+      case Stage::BAD_CAPTURES:
+        if (badIndex < badCaptures.size()) {
+          return badCaptures[badIndex++];
+        }
+        stage = Stage::DONE;
+        break;
+
+      case Stage::GEN_QUIET_CHECKS:
+        movegen::legalmoves<movegen::MoveGenType::QUIET>(moves, board);
+        search.countMoveGen();
+        index = 0;
+        stage = Stage::QUIET_CHECKS;
+        break;
+
+      // Unscored: these only run at the first qsearch ply and are rarely
+      // more than a handful, so the check test itself is the filter.
+      case Stage::QUIET_CHECKS:
+        while (index < moves.size()) {
+          const Move move = moves[index++];
+          if (move == ttMove || move.typeOf() == Move::CASTLING || isQueenPromotion(move)) {
+            continue;
+          }
+          if (givesCheck(move)) return move;
+        }
+        stage = Stage::DONE;
+        break;
+
+      case Stage::GEN_EVASIONS:
+        movegen::legalmoves<movegen::MoveGenType::ALL>(moves, board);
+        search.countMoveGen();
+        scoreEvasions();
+        index = 0;
+        stage = Stage::EVASIONS;
+        break;
+
+      case Stage::EVASIONS:
+        while (index < moves.size()) {
+          const Move move = pickBest();
+          if (move == ttMove) continue;
+          return move;
+        }
+        stage = Stage::DONE;
+        break;
+
+      case Stage::DONE:
+        return Move::NO_MOVE;
+    }
+  }
+}
+
+/*
+Quiet queen promotions belong with the captures, but the CAPTURE generator
+leaves them out. Only pay for a pawn-only quiet generation when a pawn is
+actually about to promote.
+*/
+void MovePicker::addQueenPromotions() {
+  const chess::Color us = board.sideToMove();
+  if (!(board.pieces(chess::PieceType::PAWN, us) & PROMOTION_RANK[us])) {
+    return;
+  }
+
+  chess::Movelist pawnMoves;
+  chess::movegen::legalmoves<chess::movegen::MoveGenType::QUIET>(pawnMoves, board,
+                                                                 chess::PieceGenType::PAWN);
+  search.countMoveGen();
+
+  for (const chess::Move move : pawnMoves) {
+    if (isQueenPromotion(move)) moves.add(move);
+  }
+}
+
+// MVV-LVA. SEE is deliberately not computed here, only when a capture is
+// actually picked, since most of the list is never reached at a cut node.
+void MovePicker::scoreCaptures() {
+  for (chess::Move &move : moves) {
+    int score = 0;
+
+    if (board.isCapture(move)) {
+      const chess::PieceType victim = move.typeOf() == chess::Move::ENPASSANT
+                                          ? chess::PieceType(chess::PieceType::PAWN)
+                                          : board.at(move.to()).type();
+      score += SEE_VALUES[victim] * 8 - static_cast<int>(board.at(move.from()).type());
+    }
+
+    if (move.typeOf() == chess::Move::PROMOTION) {
+      score += SEE_VALUES[move.promotionType()];
+    }
+
+    move.setScore(static_cast<int16_t>(score));
+  }
+}
+
+void MovePicker::scoreQuiets() {
+  const int stm = board.sideToMove();
+
+  for (chess::Move &move : moves) {
+    move.setScore(static_cast<int16_t>(
+        search.historyTable[stm][move.from().index()][move.to().index()]));
+  }
+}
+
+void MovePicker::scoreEvasions() {
+  const int stm = board.sideToMove();
+
+  for (chess::Move &move : moves) {
+    int score;
+
+    if (board.isCapture(move)) {
+      const chess::PieceType victim = move.typeOf() == chess::Move::ENPASSANT
+                                          ? chess::PieceType(chess::PieceType::PAWN)
+                                          : board.at(move.to()).type();
+      score = 20000 + SEE_VALUES[victim] * 8 - static_cast<int>(board.at(move.from()).type());
+    } else if (move == killer1) {
+      score = 19000;
+    } else if (move == killer2) {
+      score = 18000;
+    } else {
+      score = search.historyTable[stm][move.from().index()][move.to().index()];
+    }
+
+    move.setScore(static_cast<int16_t>(score));
+  }
+}
+
+// One step of selection sort: swap the best remaining move to the front.
+chess::Move MovePicker::pickBest() {
+  int best = index;
+  for (int i = index + 1; i < moves.size(); ++i) {
+    if (moves[i].score() > moves[best].score()) best = i;
+  }
+  std::swap(moves[index], moves[best]);
+  return moves[index++];
+}
+
+bool MovePicker::isTacticalMove(chess::Move move) const {
+  return board.isCapture(move) || isQueenPromotion(move);
+}
+
+/*
+Whether a quiet, non-castling move checks the enemy king, either directly
+from its new square or by uncovering one of our sliders. Works on a scratch
+occupancy with the move applied instead of making the move.
+*/
+bool MovePicker::givesCheck(chess::Move move) const {
+  using namespace chess;
+
+  const Color us = board.sideToMove();
+  const Square from = move.from();
+  const Square to = move.to();
+  const Square kingSq = board.kingSq(~us);
+  const Bitboard kingBB = Bitboard::fromSquare(kingSq);
+
+  Bitboard occ = board.occ();
+  occ.clear(from.index());
+  occ.set(to.index());
+
+  const PieceType pt =
+      move.typeOf() == Move::PROMOTION ? move.promotionType() : board.at(from).type();
+
+  switch (pt.internal()) {
+    case PieceType::PAWN:
+      if (attacks::pawn(us, to) & kingBB) return true;
+      break;
+    case PieceType::KNIGHT:
+      if (attacks::knight(to) & kingBB) return true;
+      break;
+    case PieceType::BISHOP:
+      if (attacks::bishop(to, occ) & kingBB) return true;
+      break;
+    case PieceType::ROOK:
+      if (attacks::rook(to, occ) & kingBB) return true;
+      break;
+    case PieceType::QUEEN:
+      if (attacks::queen(to, occ) & kingBB) return true;
+      break;
+    default:
+      break;
+  }
+
+  // Discovered check: any of our other sliders now seeing the king.
+  const Bitboard others = ~Bitboard::fromSquare(from);
+  const Bitboard bishopsQueens =
+      (board.pieces(PieceType::BISHOP, us) | board.pieces(PieceType::QUEEN, us)) & others;
+  const Bitboard rooksQueens =
+      (board.pieces(PieceType::ROOK, us) | board.pieces(PieceType::QUEEN, us)) & others;
+
+  return (attacks::bishop(kingSq, occ) & bishopsQueens) ||
+         (attacks::rook(kingSq, occ) & rooksQueens);
+}
+
+/*
+Full legality check for a move that wasn't generated in this position (TT
+move or killer). Castling and en passant are rare enough that they're
+simply looked up in the moving piece's generated moves; everything else is
+checked geometrically and then by asking whether our king would be
+attacked with the move played on a scratch occupancy.
+*/
+bool MovePicker::isLegal(chess::Move move) const {
+  using namespace chess;
+
+  if (move == Move::NULL_MOVE || move == Move::NO_MOVE) return false;
+
+  // Only promotions may carry promotion bits; anything else is garbage.
+  if (move.typeOf() != Move::PROMOTION && (move.move() & 0x3000)) return false;
+
+  const Color us = board.sideToMove();
+  const Square from = move.from();
+  const Square to = move.to();
+  const Piece piece = board.at(from);
+
+  if (piece == Piece::NONE || piece.color() != us) return false;
+
+  const PieceType pt = piece.type();
+
+  if (move.typeOf() == Move::CASTLING || move.typeOf() == Move::ENPASSANT) {
+    const int genType = move.typeOf() == Move::CASTLING ? PieceGenType::KING : PieceGenType::PAWN;
+    Movelist pieceMoves;
+    movegen::legalmoves(pieceMoves, board, genType);
+    search.countMoveGen();
+    return std::find(pieceMoves.begin(), pieceMoves.end(), move) != pieceMoves.end();
+  }
+
+  const Piece captured = board.at(to);
+  if (captured != Piece::NONE && (captured.color() == us || captured.type() == PieceType::KING)) {
+    return false;
+  }
+
+  Bitboard occ = board.occ();
+
+  if (pt == PieceType::PAWN) {
+    const int forward = us == Color::WHITE ? 8 : -8;
+    const bool lastRank = to.rank() == (us == Color::WHITE ? Rank::RANK_8 : Rank::RANK_1);
+    if (lastRank != (move.typeOf() == Move::PROMOTION)) return false;
+
+    if (captured != Piece::NONE) {
+      if (!(attacks::pawn(us, from) & Bitboard::fromSquare(to))) return false;
+    } else if (to.index() == from.index() + forward) {
+      // single push onto an empty square, nothing else to check
+    } else if (to.index() == from.index() + 2 * forward) {
+      const Rank startRank = us == Color::WHITE ? Rank::RANK_2 : Rank::RANK_7;
+      if (from.rank() != startRank || occ.check(from.index() + forward)) return false;
+    } else {
+      return false;
+    }
+  } else {
+    if (move.typeOf() == Move::PROMOTION) return false;
+
+    Bitboard reach;
+    switch (pt.internal()) {
+      case PieceType::KNIGHT: reach = attacks::knight(from); break;
+      case PieceType::BISHOP: reach = attacks::bishop(from, occ); break;
+      case PieceType::ROOK:   reach = attacks::rook(from, occ); break;
+      case PieceType::QUEEN:  reach = attacks::queen(from, occ); break;
+      default:                reach = attacks::king(from); break;
+    }
+    if (!(reach & Bitboard::fromSquare(to))) return false;
+  }
+
+  occ.clear(from.index());
+  occ.set(to.index());
+
+  const Square kingSq = pt == PieceType::KING ? to : board.kingSq(us);
+  const Bitboard them = board.us(~us) & ~Bitboard::fromSquare(to);
+
+  const Bitboard bishopsQueens =
+      (board.pieces(PieceType::BISHOP, ~us) | board.pieces(PieceType::QUEEN, ~us)) & them;
+  const Bitboard rooksQueens =
+      (board.pieces(PieceType::ROOK, ~us) | board.pieces(PieceType::QUEEN, ~us)) & them;
+
+  if (attacks::pawn(us, kingSq) & board.pieces(PieceType::PAWN, ~us) & them) return false;
+  if (attacks::knight(kingSq) & board.pieces(PieceType::KNIGHT, ~us) & them) return false;
+  if (attacks::king(kingSq) & board.pieces(PieceType::KING, ~us)) return false;
+  if (attacks::bishop(kingSq, occ) & bishopsQueens) return false;
+  if (attacks::rook(kingSq, occ) & rooksQueens) return false;
+
+  return true;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "chess.hpp"
+
+class Search;
+
+/*
+Hands out the moves of one node, best first, doing as little work as
+possible before each move is tried. Moves are generated and scored in
+stages so that a cutoff on an early move skips everything after it:
+
+  TT move -> captures (SEE only checked when picked) -> killers -> quiets
+  -> losing captures
+
+In check every evasion is generated in one go instead. In quiescence mode
+only the good captures and queen promotions are produced (or the evasions
+when in check), optionally followed by the quiet moves that give check.
+*/
+class MovePicker {
+ public:
+  MovePicker(Search &search, chess::Move ttMove, int ply, bool isQuiescence,
+             bool quietChecks = false);
+
+  // Next move to search, or Move::NO_MOVE once the node is exhausted.
+  chess::Move next();
+
+ private:
+  enum class Stage {
+    TT_MOVE,
+    GEN_CAPTURES,
+    GOOD_CAPTURES,
+    KILLER_1,
+    KILLER_2,
+    GEN_QUIETS,
+    QUIETS,
+    BAD_CAPTURES,
+    GEN_QUIET_CHECKS,
+    QUIET_CHECKS,
+    GEN_EVASIONS,
+    EVASIONS,
+    DONE
+  };
+
+  Search &search;
+  const chess::Board &board;
+
+  Stage stage;
+  bool isQuiescence;
+  bool quietChecks;
+
+  chess::Move ttMove;
+  chess::Move killer1;
+  chess::Move killer2;
+
+  chess::Movelist moves;
+  int index = 0;
+
+  // Captures that failed SEE, tried after all quiets (never in qsearch).
+  chess::Movelist badCaptures;
+  int badIndex = 0;
+
+  void scoreCaptures();
+  void scoreQuiets();
+  void scoreEvasions();
+
+  void addQueenPromotions();
+
+  chess::Move pickBest();
+
+  bool isLegal(chess::Move move) const;
+  bool isTacticalMove(chess::Move move) const;
+  bool givesCheck(chess::Move move) const;
+};
@@ -2,69 +2,255 @@
 #include "nnue_data.hpp"
 #include <iostream>
 #include <cassert>
-#include <immintrin.h> // SIMD Intrinsics: Provides hardware-accelerated functions for Intel/AMD CPUs
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
-// ! This AVX2 code is written by AI GODS
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
 
 namespace NNUE {
-    alignas(32) int16_t FEATURE_WEIGHTS[INPUT_FEATURES][HIDDEN_SIZE];
-    alignas(32) int16_t FEATURE_BIASES[HIDDEN_SIZE];
-    alignas(32) int16_t OUTPUT_WEIGHTS[HIDDEN_SIZE];
-    int16_t OUTPUT_BIAS = 0;
-
-    void Network::load_network() {
-        size_t offset = 0;
-
-        // In out trainign code we go from 768 to 256
-        // The layout in the .bin file is as follows
-        // Each row has 768 int_16 values one and there are total 256 vlaues
-        // Each row maps all inputs to some hidden layer
-        // So we get 256 hidden size
-
-        // Then we have 256 cols and one row for the hidden bias
-        // then 256 cols and 1 row for the hidden weights
-        // then 1 bias vlaue for the hidden or the output bias
-        // This is the current network for now it is not much but
-        // i am happpy that i ahve something working
-        // In future for sure I will improve a lot of code and the netwrok
-
-        // FEATURE_WEIGHTS [INPUT_FEATURES][HIDDEN_SIZE]
-        for (int r = 0; r < HIDDEN_SIZE; ++r) {
-            for (int c = 0; c < INPUT_FEATURES; ++c) {
-                FEATURE_WEIGHTS[c][r] = NNUE_DATA[offset++];
+    static_assert(sizeof(NNUE_DATA) == NET_VALUES * sizeof(int16_t),
+                  "nnue_data.hpp doesn't match INPUT_FEATURES / HIDDEN_SIZE");
+
+    namespace {
+        enum class Isa { SSE41, AVX2, AVX512BW };
+
+        // Asks the CPU, and for the wide registers also the OS, whether
+        // the instruction set can be used.
+        bool cpuHas(Isa isa) {
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+            __builtin_cpu_init();
+            switch (isa) {
+                case Isa::SSE41: return __builtin_cpu_supports("sse4.1");
+                case Isa::AVX2: return __builtin_cpu_supports("avx2");
+                case Isa::AVX512BW:
+                    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+            }
+            return false;
+#elif defined(_MSC_VER) && defined(_M_X64)
+            int regs[4];
+            __cpuid(regs, 1);
+            const bool sse41 = regs[2] & (1 << 19);
+            const bool osxsave = regs[2] & (1 << 27);
+            const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+            const bool ymmState = (xcr0 & 0x6) == 0x6;
+            const bool zmmState = (xcr0 & 0xE6) == 0xE6;
+
+            __cpuidex(regs, 7, 0);
+            switch (isa) {
+                case Isa::SSE41: return sse41;
+                case Isa::AVX2: return ymmState && (regs[1] & (1 << 5));
+                case Isa::AVX512BW:
+                    return zmmState && (regs[1] & (1 << 16)) && (regs[1] & (1 << 30));
             }
+            return false;
+#else
+            (void)isa;
+            return false;
+#endif
         }
 
-        // FEATURE_BIAS [HIDDEN_SIZE]
-        for (int i = 0; i < HIDDEN_SIZE; ++i) {
-            FEATURE_BIASES[i] = NNUE_DATA[offset++];
+        // The kernel set called `name`, if it was built and this CPU runs it.
+        const Kernels* kernelsFor(const std::string& name) {
+            if (name == "scalar") return scalarKernels();
+            if (name == "sse4.1") return cpuHas(Isa::SSE41) ? sse41Kernels() : nullptr;
+            if (name == "avx2") return cpuHas(Isa::AVX2) ? avx2Kernels() : nullptr;
+            if (name == "avx512bw") return cpuHas(Isa::AVX512BW) ? avx512Kernels() : nullptr;
+            return nullptr;
         }
 
-        // OUTPUT_WEIGHTS [HIDDEN_SIZE]
-        for (int i = 0; i < HIDDEN_SIZE; ++i) {
-            OUTPUT_WEIGHTS[i] = NNUE_DATA[offset++];
+        const Kernels* bestKernels() {
+            for (const char* name : {"avx512bw", "avx2", "sse4.1"}) {
+                if (const Kernels* k = kernelsFor(name)) return k;
+            }
+            return scalarKernels();
+        }
+
+        const Kernels* active = bestKernels();
+    } // namespace
+
+    bool selectKernels(const std::string& name) {
+        const Kernels* k = (name == "auto") ? bestKernels() : kernelsFor(name);
+        if (!k) return false;
+        active = k;
+        return true;
+    }
+
+    const char* kernelName() { return active->name; }
+
+    namespace {
+        constexpr char NET_FILE_MAGIC[8] = {'I', 'N', 'D', 'U', 'S', 'N', 'N', '\0'};
+        constexpr uint32_t NET_FILE_VERSION = 1;
+        constexpr uint32_t NET_ARCHITECTURE = 1;
+        constexpr uint64_t NET_PAYLOAD_BYTES = NET_VALUES * sizeof(int16_t);
+
+        struct alignas(64) NetBlock {
+            int16_t values[NET_VALUES];
+        };
+
+        // Weights of a net loaded from a file; null while the embedded net is in use.
+        std::unique_ptr<NetBlock> fileNet;
+        std::string loadedNet = "<embedded>";
+
+        // zlib's CRC-32, as Python's zlib.crc32 computes it
+        uint32_t crc32(const unsigned char* data, size_t size) {
+            static const auto table = [] {
+                std::array<uint32_t, 256> t{};
+                for (uint32_t i = 0; i < 256; ++i) {
+                    uint32_t c = i;
+                    for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                    t[i] = c;
+                }
+                return t;
+            }();
+
+            uint32_t crc = 0xFFFFFFFFu;
+            for (size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+            return crc ^ 0xFFFFFFFFu;
+        }
+
+        bool validNet(const NetFileHeader& header, uint64_t fileBytes, const unsigned char* payload,
+                      std::string& error) {
+            if (std::memcmp(header.magic, NET_FILE_MAGIC, sizeof(NET_FILE_MAGIC)) != 0) {
+                error = "not a net file";
+                return false;
+            }
+            if (header.version != NET_FILE_VERSION) {
+                error = "net file format version " + std::to_string(header.version) + " is not supported";
+                return false;
+            }
+            if (header.architecture != NET_ARCHITECTURE || header.inputFeatures != INPUT_FEATURES ||
+                header.hiddenSize != HIDDEN_SIZE || header.scale != SCALE) {
+                error = "net is " + std::to_string(header.inputFeatures) + "->" +
+                        std::to_string(header.hiddenSize) + " (architecture " +
+                        std::to_string(header.architecture) + ", scale " +
+                        std::to_string(header.scale) + "), this build needs " +
+                        std::to_string(INPUT_FEATURES) + "->" + std::to_string(HIDDEN_SIZE);
+                return false;
+            }
+            if (header.payloadBytes != NET_PAYLOAD_BYTES ||
+                fileBytes != sizeof(NetFileHeader) + NET_PAYLOAD_BYTES) {
+                error = "net file is truncated or corrupt";
+                return false;
+            }
+            if (crc32(payload, NET_PAYLOAD_BYTES) != header.checksum) {
+                error = "net file checksum mismatch";
+                return false;
+            }
+            return true;
         }
 
-        // OUTPUT_BIAS
-        OUTPUT_BIAS = NNUE_DATA[offset++];
+    } // namespace
+
+    Network& Network::instance() {
+        static Network net(NNUE_DATA);
+        return net;
+    }
+
+    const Network& network() { return Network::instance(); }
+
+    // Every part of the block starts on a 64-byte boundary: the feature
+    // weights and the biases are whole multiples of 32 values.
+    void Network::use(const int16_t* block) {
+        featureWeights = block;
+        featureBiases = featureWeights + INPUT_FEATURES * HIDDEN_SIZE;
+        outputWeights = featureBiases + HIDDEN_SIZE;
+        outputBias = outputWeights[HIDDEN_SIZE];
     }
 
-    void Network::refreshAccumulator(const chess::Board &board, Accumulator &acc) {
-        // Start from the bias
-#ifdef USE_AVX2
-        // AVX2 Optimization: Load and store 16 x 16-bit values at a time using 256-bit registers (__m256i)
-        for (int i = 0; i < HIDDEN_SIZE; i += 16) {
-            // _mm256_load_si256: Loads 256 bits of data from a 32-byte aligned memory address
-            // _mm256_store_si256: Stores 256 bits of data to a 32-byte aligned memory address
-            _mm256_store_si256((__m256i*)&acc.values[i], _mm256_load_si256((__m256i*)&FEATURE_BIASES[i]));
+    void loadEmbeddedNetwork() {
+        Network::instance().use(NNUE_DATA);
+        fileNet.reset();
+        loadedNet = "<embedded>";
+    }
+
+    const std::string& networkName() { return loadedNet; }
+
+    /*
+    The whole file is checked (header, sizes, checksum) before any weight
+    is touched, so a bad file leaves the current net in place. On Linux the
+    file is mapped read-only and copied straight from the page cache.
+    */
+    bool loadNetworkFile(const std::string& path, std::string& error) {
+        const unsigned char* data = nullptr;
+        uint64_t fileBytes = 0;
+
+#if defined(__linux__)
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error = "cannot open " + path;
+            return false;
         }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(NetFileHeader)) {
+            close(fd);
+            error = "net file is truncated or corrupt";
+            return false;
+        }
+
+        fileBytes = static_cast<uint64_t>(info.st_size);
+        void* mapped = mmap(nullptr, fileBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            error = "cannot map " + path;
+            return false;
+        }
+        data = static_cast<const unsigned char*>(mapped);
 #else
-        for (int i = 0; i < HIDDEN_SIZE; ++i) {
-            acc.values[i] = FEATURE_BIASES[i];
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) {
+            error = "cannot open " + path;
+            return false;
+        }
+
+        fileBytes = static_cast<uint64_t>(in.tellg());
+        if (fileBytes < sizeof(NetFileHeader) ||
+            fileBytes > sizeof(NetFileHeader) + NET_PAYLOAD_BYTES) {
+            error = "net file is truncated or corrupt";
+            return false;
         }
+        std::vector<unsigned char> buffer(fileBytes);
+        in.seekg(0);
+        if (!in.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(fileBytes))) {
+            error = "read from " + path + " failed";
+            return false;
+        }
+        data = buffer.data();
 #endif
 
-        // Now let's add the active peice features
+        NetFileHeader header;
+        std::memcpy(&header, data, sizeof(header));
+        const bool ok = validNet(header, fileBytes, data + sizeof(NetFileHeader), error);
+        if (ok) {
+            auto block = std::make_unique<NetBlock>();
+            std::memcpy(block->values, data + sizeof(NetFileHeader), NET_PAYLOAD_BYTES);
+            Network::instance().use(block->values);
+            fileNet = std::move(block);
+            loadedNet = path;
+        }
+
+#if defined(__linux__)
+        munmap(const_cast<unsigned char*>(data), fileBytes);
+#endif
+        return ok;
+    }
+
+    void Network::refreshAccumulator(const chess::Board &board, Accumulator &acc) const {
+        // Collect the active piece features (one per occupied square), then let
+        // the kernel add them all onto the bias in one go
+        int features[64];
+        int count = 0;
         chess::Bitboard pieces = board.us(chess::Color::WHITE) | board.us(chess::Color::BLACK);
 
         while (pieces) {
@@ -75,52 +261,25 @@ namespace NNUE {
                 continue;
 
             // Convert into 768 plane idx
-            const int idx = getPieceIndex(
-                piece.color(),
-                piece.type(),
-                sq);
-
-            for (int h = 0; h < HIDDEN_SIZE; ++h) {
-                acc.values[h] += FEATURE_WEIGHTS[idx][h];
-            }
+            features[count++] = getPieceIndex(piece.color(), piece.type(), sq);
         }
+
+        active->refresh(acc.values.data(), featureBiases, featureWeights, features, count);
     }
 
-    void Network::updateAccumulator(const chess::Board &board, chess::Move move, Accumulator &acc) {
+    FeatureDelta Network::moveDelta(const chess::Board &board, chess::Move move) {
+        FeatureDelta delta;
         const chess::Color stm = board.sideToMove();
         const auto from = move.from();
         const auto to = move.to();
         const auto piece = board.at(from);
 
         if (piece.type() == chess::PieceType::NONE) {
-            return;
+            return delta;
         }
 
-        auto updatePiece = [&](Accumulator &a, int idx, bool add) {
-#ifdef USE_AVX2
-            // SIMD Optimization for Piece Updates
-            for (int h = 0; h < HIDDEN_SIZE; h += 16) {
-                // __m256i is a 256-bit register variable. It holds 16 short integers (16-bit each).
-                __m256i acc_vec = _mm256_load_si256((__m256i*)&a.values[h]);
-                __m256i weight_vec = _mm256_load_si256((__m256i*)&FEATURE_WEIGHTS[idx][h]);
-                
-                // _mm256_add_epi16: Adds 16 pairs of 16-bit integers in one CPU cycle
-                if (add) acc_vec = _mm256_add_epi16(acc_vec, weight_vec);
-                // _mm256_sub_epi16: Subtracts 16 pairs of 16-bit integers in one CPU cycle
-                else acc_vec = _mm256_sub_epi16(acc_vec, weight_vec);
-                
-                _mm256_store_si256((__m256i*)&a.values[h], acc_vec);
-            }
-#else
-            for (int h = 0; h < HIDDEN_SIZE; ++h) {
-                if (add) a.values[h] += FEATURE_WEIGHTS[idx][h];
-                else a.values[h] -= FEATURE_WEIGHTS[idx][h];
-            }
-#endif
-        };
-
         // Remove moving piece from original square
-        updatePiece(acc, getPieceIndex(piece.color(), piece.type(), from), false);
+        delta.sub(getPieceIndex(piece.color(), piece.type(), from));
 
         if (move.typeOf() == chess::Move::CASTLING) {
             const bool king_side = (to.index() > from.index());
@@ -129,72 +288,40 @@ namespace NNUE {
             const auto king_to = chess::Square::castling_king_square(king_side, stm);
             const auto rook_to = chess::Square::castling_rook_square(king_side, stm);
 
-            updatePiece(acc, getPieceIndex(rook.color(), rook.type(), rook_from), false);
-            updatePiece(acc, getPieceIndex(rook.color(), rook.type(), rook_to), true);
-            updatePiece(acc, getPieceIndex(piece.color(), piece.type(), king_to), true);
+            delta.sub(getPieceIndex(rook.color(), rook.type(), rook_from));
+            delta.add(getPieceIndex(rook.color(), rook.type(), rook_to));
+            delta.add(getPieceIndex(piece.color(), piece.type(), king_to));
         } else if (move.typeOf() == chess::Move::PROMOTION) {
             const auto captured = board.at(to);
             if (captured != chess::Piece::NONE) {
-                updatePiece(acc, getPieceIndex(captured.color(), captured.type(), to), false);
+                delta.sub(getPieceIndex(captured.color(), captured.type(), to));
             }
-            updatePiece(acc, getPieceIndex(stm, move.promotionType(), to), true);
+            delta.add(getPieceIndex(stm, move.promotionType(), to));
         } else if (move.typeOf() == chess::Move::ENPASSANT) {
-            updatePiece(acc, getPieceIndex(piece.color(), piece.type(), to), true);
+            delta.add(getPieceIndex(piece.color(), piece.type(), to));
             const auto captured_pawn_sq = chess::Square(to.file(), from.rank());
             const auto captured_pawn = board.at(captured_pawn_sq);
-            updatePiece(acc, getPieceIndex(captured_pawn.color(), captured_pawn.type(), captured_pawn_sq), false);
+            delta.sub(getPieceIndex(captured_pawn.color(), captured_pawn.type(), captured_pawn_sq));
         } else {
             const auto captured = board.at(to);
             if (captured != chess::Piece::NONE) {
-                updatePiece(acc, getPieceIndex(captured.color(), captured.type(), to), false);
+                delta.sub(getPieceIndex(captured.color(), captured.type(), to));
             }
-            updatePiece(acc, getPieceIndex(piece.color(), piece.type(), to), true);
+            delta.add(getPieceIndex(piece.color(), piece.type(), to));
         }
-    }
 
-    // Convert sigmoid output back to cp
-    int Network::sigmoidToCp(float prob) {
-        prob = std::clamp(prob, 0.0001f, 0.9999f);
-        return static_cast<int>(
-            -400.0f * std::log10((1.0f / prob) - 1.0f));
+        return delta;
     }
 
-    // Final board evaluation
-    int Network::evaluate(chess::Color stm, const Accumulator& acc) const{
-#ifdef USE_AVX2
-        // sum_vec will hold 8 separate 32-bit integer sums
-        __m256i sum_vec = _mm256_setzero_si256();
-        const __m256i zero = _mm256_setzero_si256();
-
-        for (int i = 0; i < HIDDEN_SIZE; i += 16) {
-            __m256i acc_vec = _mm256_load_si256((const __m256i*)&acc.values[i]);
-            __m256i weight_vec = _mm256_load_si256((const __m256i*)&OUTPUT_WEIGHTS[i]);
-
-            // SCReLU/ReLU Activation: _mm256_max_epi16 handles max(0, x) for 16 values at once
-            __m256i activated = _mm256_max_epi16(acc_vec, zero);
-
-            // _mm256_madd_epi16: The "Dot-Product" instruction. 
-            // It multiplies 16-bit pairs and stores the result as 32-bit sums in 8 slots.
-            __m256i madd = _mm256_madd_epi16(activated, weight_vec);
-            sum_vec = _mm256_add_epi32(sum_vec, madd);
-        }
-
-        // Condense the 8 partial sums in sum_vec into a single scalar result
-        alignas(32) int32_t temp_sums[8];
-        _mm256_store_si256((__m256i*)temp_sums, sum_vec);
-        int32_t sum = OUTPUT_BIAS;
-        for (int i = 0; i < 8; ++i) sum += temp_sums[i];
-#else
-        int32_t sum = OUTPUT_BIAS;
-
-        // Hidden -> output
-        for (int i = 0; i < HIDDEN_SIZE; ++i) {
-            int32_t activated = std::max<int32_t>(0, acc.values[i]);
-            sum += activated * OUTPUT_WEIGHTS[i];
-        }
-#endif
+    void Network::applyDelta(const FeatureDelta &delta, const Accumulator &parent,
+                             Accumulator &child) const {
+        active->update(child.values.data(), parent.values.data(), featureWeights,
+                       delta.adds, delta.addCount, delta.subs, delta.subCount);
+    }
 
-        // Undo the scaling from the export 
+    // The original mapping: the sigmoid the trainer used, then its inverse
+    // scaled to cp. Kept as the reference for sumToCp.
+    int Network::sumToCpFloat(int32_t sum) {
         // Undo scaling from export (*255 twice)
         float x = static_cast<float>(sum) /
         static_cast<float>(SCALE * SCALE);
@@ -202,12 +329,38 @@ namespace NNUE {
         // Same sigmoid as PyTorch
         // prob is the probability of winning for for given side out of 1
         float prob = 1.0f / (1.0f + std::exp(-x));
-        
-        // We can convert this probability to cp value
-        int cp = sigmoidToCp(prob);
+
+        prob = std::clamp(prob, 0.0001f, 0.9999f);
+        return static_cast<int>(
+            -400.0f * std::log10((1.0f / prob) - 1.0f));
+    }
+
+    // -400 * log10(1 / sigmoid(x) - 1) is exactly 400 * x / ln(10), so the
+    // sigmoid and its inverse cancel and only a linear scale is left:
+    //   cp = sum * 400 / (ln(10) * SCALE * SCALE)   (0.00267155... at 255)
+    // done as a 32.32 fixed-point multiply, truncated toward zero like the
+    // float cast. The float path clamps prob to [0.0001, 0.9999], which is
+    // |x| <= ln(9999) = 9.2102, or 1599.98 cp: hence the cap at 1599.
+    int Network::sumToCp(int32_t sum) {
+        constexpr double LN_10 = 2.302585092994045684;
+        constexpr int64_t CP_PER_SUM_FP32 = static_cast<int64_t>(
+            4294967296.0 * 400.0 / (LN_10 * SCALE * SCALE) + 0.5);  // rounded 2^32 * cp per sum
+        constexpr int64_t CP_LIMIT = 1599;
+
+        const int64_t magnitude = sum < 0 ? -int64_t(sum) : int64_t(sum);
+        const int cp = static_cast<int>(std::min((magnitude * CP_PER_SUM_FP32) >> 32, CP_LIMIT));
+        return sum < 0 ? -cp : cp;
+    }
+
+    // Final board evaluation
+    int Network::evaluate(chess::Color stm, const Accumulator& acc) const{
+        // Hidden -> output
+        int32_t sum = outputBias + active->output(acc.values.data(), outputWeights);
+
+        int cp = sumToCp(sum);
 
         // Return from side-to-move perspective
         return (stm == chess::Color::WHITE) ? cp : -cp;
     }
 
-}
\ No newline at end of file
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "chess.hpp"
+#include "nnue_kernels.hpp"
 #include <array>
 #include <cstdint>
 #include <fstream>
@@ -9,17 +10,32 @@
 #include <cmath>
 
 namespace NNUE {
-  // First define some constants
-  constexpr int INPUT_FEATURES = 768;
-  constexpr int HIDDEN_SIZE = 256;
-  constexpr int SCALE = 255;
-
-  alignas(32) extern int16_t FEATURE_WEIGHTS[INPUT_FEATURES][HIDDEN_SIZE];
-  alignas(32) extern int16_t FEATURE_BIASES[HIDDEN_SIZE];
-  alignas(32) extern int16_t OUTPUT_WEIGHTS[HIDDEN_SIZE];
-  alignas(32) extern int16_t OUTPUT_BIAS;
-    
-  struct alignas(32) Accumulator {
+  // INPUT_FEATURES, HIDDEN_SIZE and SCALE live in nnue_kernels.hpp
+
+  // A net is one block of int16 values, the same in nnue_data.hpp and in
+  // net files: feature weights [INPUT_FEATURES][HIDDEN_SIZE] (already in
+  // the order the kernels read), hidden biases [HIDDEN_SIZE], output
+  // weights [HIDDEN_SIZE], output bias.
+  constexpr size_t NET_VALUES = size_t(INPUT_FEATURES) * HIDDEN_SIZE + 2 * HIDDEN_SIZE + 1;
+
+  // Net files (written by networks_training/export_to_binary.py) are this
+  // header followed by the block above as little-endian int16. A file for
+  // another architecture or size is refused.
+  struct NetFileHeader {
+    char magic[8];          // "INDUSNN\0"
+    uint32_t version;       // NET_FILE_VERSION, bumped whenever the layout changes
+    uint32_t architecture;  // 1: INPUT_FEATURES -> HIDDEN_SIZE ReLU -> 1
+    uint32_t inputFeatures;
+    uint32_t hiddenSize;
+    uint32_t scale;
+    uint32_t checksum;      // CRC-32 (zlib's) of the payload
+    uint64_t payloadBytes;
+    uint8_t reserved[24];
+  };
+
+  static_assert(sizeof(NetFileHeader) == 64, "net files start with a 64-byte header");
+
+  struct alignas(64) Accumulator {
     std::array<int16_t, HIDDEN_SIZE>values;
 
     Accumulator() {
@@ -27,19 +43,75 @@ namespace NNUE {
     }
   };
 
+  // The feature rows one move adds and removes: the moved piece (or its
+  // promotion) and a castling rook go on, the piece's origin, a castling
+  // rook's origin and any captured piece come off.
+  struct FeatureDelta {
+    int adds[2];
+    int subs[2];
+    int addCount = 0;
+    int subCount = 0;
+
+    void add(int idx) { adds[addCount++] = idx; }
+    void sub(int idx) { subs[subCount++] = idx; }
+  };
+
+  // Read-only after loading, so every Search shares the one instance that
+  // network() returns. It points into the weight block instead of copying
+  // it: the embedded net is used in place, straight from NNUE_DATA.
   class Network {
   public:
-    void load_network();
-    void refreshAccumulator(const chess::Board& board, Accumulator& acc);
-    // NEW: Efficiently updatable refresher
-    void updateAccumulator(const chess::Board& board, chess::Move move, Accumulator& acc);
+    Network(const Network&) = delete;
+    Network& operator=(const Network&) = delete;
+
+    void refreshAccumulator(const chess::Board& board, Accumulator& acc) const;
+    // The features `move` changes; `board` is the position before it.
+    static FeatureDelta moveDelta(const chess::Board& board, chess::Move move);
+    // Builds the child's accumulator from the parent's in a single pass;
+    // parent and child may be the same.
+    void applyDelta(const FeatureDelta& delta, const Accumulator& parent, Accumulator& child) const;
     int evaluate(chess::Color stm, const Accumulator& acc) const;
 
+    // Output-layer sum to centipawns from white's view. sumToCp is the
+    // integer mapping evaluate() uses; sumToCpFloat is the original
+    // sigmoid/log10 version, kept for the `evalcheck` comparison.
+    static int sumToCp(int32_t sum);
+    static int sumToCpFloat(int32_t sum);
+
   private:
-    static int sigmoidToCp(float prob);
+    friend const Network& network();
+    friend bool loadNetworkFile(const std::string& path, std::string& error);
+    friend void loadEmbeddedNetwork();
+
+    explicit Network(const int16_t* block) { use(block); }
+    static Network& instance();
 
+    // `block` holds NET_VALUES values, is 64-byte aligned and outlives its use.
+    void use(const int16_t* block);
+
+    const int16_t* featureWeights = nullptr;
+    const int16_t* featureBiases = nullptr;
+    const int16_t* outputWeights = nullptr;
+    int16_t outputBias = 0;
   };
 
+  // The process-wide net, starting out as the embedded one. loadNetworkFile
+  // swaps in a net file (on failure `error` says why and the current net
+  // stays) and loadEmbeddedNetwork goes back to the built-in one. Both
+  // change the shared instance, so only call them while no search runs.
+  const Network& network();
+  bool loadNetworkFile(const std::string& path, std::string& error);
+  void loadEmbeddedNetwork();
+  // "<embedded>" or the path of the loaded net file
+  const std::string& networkName();
+
+  // The kernels every Network uses. At startup this is the fastest set the
+  // CPU supports. selectKernels forces one by name (scalar, sse4.1, avx2,
+  // avx512bw, or auto for the default) and returns false, changing
+  // nothing, if this CPU or build can't run it. Only call between searches.
+  bool selectKernels(const std::string& name);
+  const char* kernelName();
+
   inline int getPieceIndex(chess::Color c, chess::PieceType pt, chess::Square sq){
     // Python dataset reads FEN from A8 -> H1.
     // chess libs use A1 = 0, so we flip ranks.
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+The hot NNUE loops, built once per instruction set. Each
+nnue_kernels_<isa>.cpp is compiled with its own -m flags (see
+CMakeLists.txt) and hands out a table of function pointers; nnue.cpp picks
+the best table the CPU supports at startup, so one binary runs everywhere.
+
+Keep this header free of other project includes. Anything inline that a
+kernel TU pulls in gets compiled with that TU's instruction set, and the
+linker may keep that copy for the whole program — an AVX-512 std::max on a
+machine without AVX-512 is an illegal instruction.
+*/
+namespace NNUE {
+
+constexpr int INPUT_FEATURES = 768;
+constexpr int HIDDEN_SIZE = 256;
+constexpr int SCALE = 255;
+
+// All kernels give bit-identical results, so the choice never changes a
+// search. Pointers passed in must be 64-byte aligned.
+struct Kernels {
+  const char *name;
+
+  // acc = bias + the rows of `weights` ([INPUT_FEATURES][HIDDEN_SIZE])
+  // listed in features[0..count). The SIMD versions hold a tile of the
+  // accumulator in registers across all rows and store it once.
+  void (*refresh)(int16_t *acc, const int16_t *bias, const int16_t *weights,
+                  const int *features, int count);
+
+  // Accumulator lanes are int16 and wrap on overflow, as in the trainer.
+
+  // dst = src + the rows in adds[0..addCount) - the rows in subs[0..subCount),
+  // reading src and writing dst once. This is a whole move's update of a
+  // child accumulator from its parent; src == dst updates in place.
+  void (*update)(int16_t *dst, const int16_t *src, const int16_t *weights, const int *adds,
+                 int addCount, const int *subs, int subCount);
+
+  // Sum of max(0, acc[h]) * weights[h], without the output bias.
+  int32_t (*output)(const int16_t *acc, const int16_t *weights);
+};
+
+// nullptr when the compiler couldn't build that instruction set.
+const Kernels *scalarKernels();
+const Kernels *sse41Kernels();
+const Kernels *avx2Kernels();
+const Kernels *avx512Kernels();
+
+}  // namespace NNUE
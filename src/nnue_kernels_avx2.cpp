@@ -0,0 +1,103 @@
+#include "nnue_kernels.hpp"
+
+// Built with -mavx2 (/arch:AVX2 on MSVC).
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+namespace NNUE {
+namespace {
+
+constexpr int LANES = 16;  // int16 per __m256i
+
+// All sixteen ymm registers hold the whole accumulator: one pass over the
+// rows. The adds take the weights straight from memory, so nothing spills.
+constexpr int TILE_REGS = 16;
+constexpr int TILE = TILE_REGS * LANES;
+static_assert(HIDDEN_SIZE % TILE == 0, "refresh tiles must cover the accumulator");
+
+void refresh(int16_t *acc, const int16_t *bias, const int16_t *weights, const int *features,
+             int count) {
+  for (int base = 0; base < HIDDEN_SIZE; base += TILE) {
+    __m256i regs[TILE_REGS];
+    for (int r = 0; r < TILE_REGS; ++r) {
+      regs[r] = _mm256_load_si256(reinterpret_cast<const __m256i *>(bias + base + r * LANES));
+    }
+
+    for (int i = 0; i < count; ++i) {
+      const int16_t *row = weights + features[i] * HIDDEN_SIZE + base;
+      for (int r = 0; r < TILE_REGS; ++r) {
+        const __m256i w = _mm256_load_si256(reinterpret_cast<const __m256i *>(row + r * LANES));
+        regs[r] = _mm256_add_epi16(regs[r], w);
+      }
+    }
+
+    for (int r = 0; r < TILE_REGS; ++r) {
+      _mm256_store_si256(reinterpret_cast<__m256i *>(acc + base + r * LANES), regs[r]);
+    }
+  }
+}
+
+// Same tiling as refresh: the parent tile is loaded once, every row is
+// applied in registers, and the child tile is stored once.
+void update(int16_t *dst, const int16_t *src, const int16_t *weights, const int *adds,
+            int addCount, const int *subs, int subCount) {
+  for (int base = 0; base < HIDDEN_SIZE; base += TILE) {
+    __m256i regs[TILE_REGS];
+    for (int r = 0; r < TILE_REGS; ++r) {
+      regs[r] = _mm256_load_si256(reinterpret_cast<const __m256i *>(src + base + r * LANES));
+    }
+
+    for (int i = 0; i < addCount; ++i) {
+      const int16_t *row = weights + adds[i] * HIDDEN_SIZE + base;
+      for (int r = 0; r < TILE_REGS; ++r) {
+        const __m256i w = _mm256_load_si256(reinterpret_cast<const __m256i *>(row + r * LANES));
+        regs[r] = _mm256_add_epi16(regs[r], w);
+      }
+    }
+    for (int i = 0; i < subCount; ++i) {
+      const int16_t *row = weights + subs[i] * HIDDEN_SIZE + base;
+      for (int r = 0; r < TILE_REGS; ++r) {
+        const __m256i w = _mm256_load_si256(reinterpret_cast<const __m256i *>(row + r * LANES));
+        regs[r] = _mm256_sub_epi16(regs[r], w);
+      }
+    }
+
+    for (int r = 0; r < TILE_REGS; ++r) {
+      _mm256_store_si256(reinterpret_cast<__m256i *>(dst + base + r * LANES), regs[r]);
+    }
+  }
+}
+
+int32_t output(const int16_t *acc, const int16_t *weights) {
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i sum = _mm256_setzero_si256();
+
+  for (int h = 0; h < HIDDEN_SIZE; h += LANES) {
+    const __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i *>(acc + h));
+    const __m256i w = _mm256_load_si256(reinterpret_cast<const __m256i *>(weights + h));
+    // ReLU, then multiply pairs and add them into eight int32 lanes.
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_max_epi16(a, zero), w));
+  }
+
+  __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+  half = _mm_hadd_epi32(half, half);
+  half = _mm_hadd_epi32(half, half);
+  return _mm_cvtsi128_si32(half);
+}
+
+const Kernels KERNELS = {"avx2", refresh, update, output};
+
+}  // namespace
+
+const Kernels *avx2Kernels() { return &KERNELS; }
+
+}  // namespace NNUE
+
+#else
+
+namespace NNUE {
+const Kernels *avx2Kernels() { return nullptr; }
+}  // namespace NNUE
+
+#endif
@@ -0,0 +1,110 @@
+#include "nnue_kernels.hpp"
+
+// Built with -mavx512f -mavx512bw (/arch:AVX512 on MSVC).
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+
+#include <immintrin.h>
+
+namespace NNUE {
+namespace {
+
+constexpr int LANES = 32;  // int16 per __m512i
+
+// Eight zmm registers hold the whole accumulator: one pass over the rows.
+constexpr int TILE_REGS = 8;
+constexpr int TILE = TILE_REGS * LANES;
+static_assert(HIDDEN_SIZE % TILE == 0, "refresh tiles must cover the accumulator");
+
+void refresh(int16_t *acc, const int16_t *bias, const int16_t *weights, const int *features,
+             int count) {
+  for (int base = 0; base < HIDDEN_SIZE; base += TILE) {
+    __m512i regs[TILE_REGS];
+    for (int r = 0; r < TILE_REGS; ++r) {
+      regs[r] = _mm512_load_si512(bias + base + r * LANES);
+    }
+
+    for (int i = 0; i < count; ++i) {
+      const int16_t *row = weights + features[i] * HIDDEN_SIZE + base;
+      for (int r = 0; r < TILE_REGS; ++r) {
+        const __m512i w = _mm512_load_si512(row + r * LANES);
+        regs[r] = _mm512_add_epi16(regs[r], w);
+      }
+    }
+
+    for (int r = 0; r < TILE_REGS; ++r) {
+      _mm512_store_si512(acc + base + r * LANES, regs[r]);
+    }
+  }
+}
+
+// Same tiling as refresh: the parent tile is loaded once, every row is
+// applied in registers, and the child tile is stored once.
+void update(int16_t *dst, const int16_t *src, const int16_t *weights, const int *adds,
+            int addCount, const int *subs, int subCount) {
+  for (int base = 0; base < HIDDEN_SIZE; base += TILE) {
+    __m512i regs[TILE_REGS];
+    for (int r = 0; r < TILE_REGS; ++r) {
+      regs[r] = _mm512_load_si512(src + base + r * LANES);
+    }
+
+    for (int i = 0; i < addCount; ++i) {
+      const int16_t *row = weights + adds[i] * HIDDEN_SIZE + base;
+      for (int r = 0; r < TILE_REGS; ++r) {
+        const __m512i w = _mm512_load_si512(row + r * LANES);
+        regs[r] = _mm512_add_epi16(regs[r], w);
+      }
+    }
+    for (int i = 0; i < subCount; ++i) {
+      const int16_t *row = weights + subs[i] * HIDDEN_SIZE + base;
+      for (int r = 0; r < TILE_REGS; ++r) {
+        const __m512i w = _mm512_load_si512(row + r * LANES);
+        regs[r] = _mm512_sub_epi16(regs[r], w);
+      }
+    }
+
+    for (int r = 0; r < TILE_REGS; ++r) {
+      _mm512_store_si512(dst + base + r * LANES, regs[r]);
+    }
+  }
+}
+
+int32_t output(const int16_t *acc, const int16_t *weights) {
+  const __m512i zero = _mm512_setzero_si512();
+  __m512i sum = _mm512_setzero_si512();
+
+  for (int h = 0; h < HIDDEN_SIZE; h += LANES) {
+    const __m512i a = _mm512_load_si512(acc + h);
+    const __m512i w = _mm512_load_si512(weights + h);
+    // ReLU, then multiply pairs and add them into sixteen int32 lanes.
+    sum = _mm512_add_epi32(sum, _mm512_madd_epi16(_mm512_max_epi16(a, zero), w));
+  }
+
+  // Fold to 256 and then 128 bits and finish like the AVX2 kernel. A
+  // zero-masked extract with a full mask is a plain vextracti64x4; the
+  // unmasked extract, the 512->256 cast and _mm512_reduce_add_epi32 all
+  // trip -Wuninitialized inside GCC 12's headers.
+  const __m256i low = _mm512_maskz_extracti64x4_epi64(0xFF, sum, 0);
+  const __m256i high = _mm512_maskz_extracti64x4_epi64(0xFF, sum, 1);
+  const __m256i quarter = _mm256_add_epi32(low, high);
+  __m128i half =
+      _mm_add_epi32(_mm256_castsi256_si128(quarter), _mm256_extracti128_si256(quarter, 1));
+  half = _mm_hadd_epi32(half, half);
+  half = _mm_hadd_epi32(half, half);
+  return _mm_cvtsi128_si32(half);
+}
+
+const Kernels KERNELS = {"avx512bw", refresh, update, output};
+
+}  // namespace
+
+const Kernels *avx512Kernels() { return &KERNELS; }
+
+}  // namespace NNUE
+
+#else
+
+namespace NNUE {
+const Kernels *avx512Kernels() { return nullptr; }
+}  // namespace NNUE
+
+#endif
@@ -0,0 +1,53 @@
+#include "nnue_kernels.hpp"
+
+// Plain loops, the fallback for any CPU. Compilers still vectorize these
+// with the baseline instruction set (SSE2 on x86-64).
+
+namespace NNUE {
+namespace {
+
+void addRow(int16_t *acc, const int16_t *row) {
+  for (int h = 0; h < HIDDEN_SIZE; ++h) {
+    acc[h] = static_cast<int16_t>(acc[h] + row[h]);
+  }
+}
+
+void subRow(int16_t *acc, const int16_t *row) {
+  for (int h = 0; h < HIDDEN_SIZE; ++h) {
+    acc[h] = static_cast<int16_t>(acc[h] - row[h]);
+  }
+}
+
+void refresh(int16_t *acc, const int16_t *bias, const int16_t *weights, const int *features,
+             int count) {
+  for (int h = 0; h < HIDDEN_SIZE; ++h) acc[h] = bias[h];
+  for (int i = 0; i < count; ++i) addRow(acc, weights + features[i] * HIDDEN_SIZE);
+}
+
+// One pass per row here: the compiler vectorizes each of these loops, but
+// not a loop over a runtime number of rows inside the lane loop.
+void update(int16_t *dst, const int16_t *src, const int16_t *weights, const int *adds,
+            int addCount, const int *subs, int subCount) {
+  if (dst != src) {
+    for (int h = 0; h < HIDDEN_SIZE; ++h) dst[h] = src[h];
+  }
+  for (int i = 0; i < addCount; ++i) addRow(dst, weights + adds[i] * HIDDEN_SIZE);
+  for (int i = 0; i < subCount; ++i) subRow(dst, weights + subs[i] * HIDDEN_SIZE);
+}
+
+int32_t output(const int16_t *acc, const int16_t *weights) {
+  int32_t sum = 0;
+  for (int h = 0; h < HIDDEN_SIZE; ++h) {
+    const int32_t activated = acc[h] > 0 ? acc[h] : 0;
+    sum += activated * weights[h];
+  }
+  return sum;
+}
+
+const Kernels KERNELS = {"scalar", refresh, update, output};
+
+}  // namespace
+
+const Kernels *scalarKernels() { return &KERNELS; }
+
+}  // namespace NNUE
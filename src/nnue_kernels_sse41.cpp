@@ -0,0 +1,102 @@
+#include "nnue_kernels.hpp"
+
+// Built with -msse4.1. MSVC has no switch for it: every x64 target
+// accepts the intrinsics, and the dispatcher checks the CPU.
+#if defined(__SSE4_1__) || (defined(_MSC_VER) && defined(_M_X64))
+
+#include <smmintrin.h>
+
+namespace NNUE {
+namespace {
+
+constexpr int LANES = 8;  // int16 per __m128i
+
+// All sixteen xmm registers: 128 lanes per pass over the rows, two passes.
+constexpr int TILE_REGS = 16;
+constexpr int TILE = TILE_REGS * LANES;
+static_assert(HIDDEN_SIZE % TILE == 0, "refresh tiles must cover the accumulator");
+
+void refresh(int16_t *acc, const int16_t *bias, const int16_t *weights, const int *features,
+             int count) {
+  for (int base = 0; base < HIDDEN_SIZE; base += TILE) {
+    __m128i regs[TILE_REGS];
+    for (int r = 0; r < TILE_REGS; ++r) {
+      regs[r] = _mm_load_si128(reinterpret_cast<const __m128i *>(bias + base + r * LANES));
+    }
+
+    for (int i = 0; i < count; ++i) {
+      const int16_t *row = weights + features[i] * HIDDEN_SIZE + base;
+      for (int r = 0; r < TILE_REGS; ++r) {
+        const __m128i w = _mm_load_si128(reinterpret_cast<const __m128i *>(row + r * LANES));
+        regs[r] = _mm_add_epi16(regs[r], w);
+      }
+    }
+
+    for (int r = 0; r < TILE_REGS; ++r) {
+      _mm_store_si128(reinterpret_cast<__m128i *>(acc + base + r * LANES), regs[r]);
+    }
+  }
+}
+
+// Same tiling as refresh: the parent tile is loaded once, every row is
+// applied in registers, and the child tile is stored once.
+void update(int16_t *dst, const int16_t *src, const int16_t *weights, const int *adds,
+            int addCount, const int *subs, int subCount) {
+  for (int base = 0; base < HIDDEN_SIZE; base += TILE) {
+    __m128i regs[TILE_REGS];
+    for (int r = 0; r < TILE_REGS; ++r) {
+      regs[r] = _mm_load_si128(reinterpret_cast<const __m128i *>(src + base + r * LANES));
+    }
+
+    for (int i = 0; i < addCount; ++i) {
+      const int16_t *row = weights + adds[i] * HIDDEN_SIZE + base;
+      for (int r = 0; r < TILE_REGS; ++r) {
+        const __m128i w = _mm_load_si128(reinterpret_cast<const __m128i *>(row + r * LANES));
+        regs[r] = _mm_add_epi16(regs[r], w);
+      }
+    }
+    for (int i = 0; i < subCount; ++i) {
+      const int16_t *row = weights + subs[i] * HIDDEN_SIZE + base;
+      for (int r = 0; r < TILE_REGS; ++r) {
+        const __m128i w = _mm_load_si128(reinterpret_cast<const __m128i *>(row + r * LANES));
+        regs[r] = _mm_sub_epi16(regs[r], w);
+      }
+    }
+
+    for (int r = 0; r < TILE_REGS; ++r) {
+      _mm_store_si128(reinterpret_cast<__m128i *>(dst + base + r * LANES), regs[r]);
+    }
+  }
+}
+
+int32_t output(const int16_t *acc, const int16_t *weights) {
+  const __m128i zero = _mm_setzero_si128();
+  __m128i sum = _mm_setzero_si128();
+
+  for (int h = 0; h < HIDDEN_SIZE; h += LANES) {
+    const __m128i a = _mm_load_si128(reinterpret_cast<const __m128i *>(acc + h));
+    const __m128i w = _mm_load_si128(reinterpret_cast<const __m128i *>(weights + h));
+    // ReLU, then multiply pairs and add them into four int32 lanes.
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_max_epi16(a, zero), w));
+  }
+
+  sum = _mm_hadd_epi32(sum, sum);
+  sum = _mm_hadd_epi32(sum, sum);
+  return _mm_cvtsi128_si32(sum);
+}
+
+const Kernels KERNELS = {"sse4.1", refresh, update, output};
+
+}  // namespace
+
+const Kernels *sse41Kernels() { return &KERNELS; }
+
+}  // namespace NNUE
+
+#else
+
+namespace NNUE {
+const Kernels *sse41Kernels() { return nullptr; }
+}  // namespace NNUE
+
+#endif
@@ -1,82 +1,151 @@
 #include "search.hpp"
 
-#ifdef _WIN32
-#include <conio.h>
-#include <windows.h>
-#else
-#include <poll.h>
-#include <unistd.h>
-#endif
-
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <fstream>
+#include <thread>
+
+#include "zobrist_keys.hpp"
+
+Search::Search(chess::Board &board, TranspositionTable &tt_helper)
+    : board(board), tt_helper(tt_helper), nnue(NNUE::network()) {}
+
+Search::~Search() { stopHelpers(); }
+
+void Search::setQsearchChecks(bool enabled) {
+  qsearchChecks = enabled;
+  for (auto &helper : helpers) {
+    helper->search.qsearchChecks = enabled;
+  }
+}
+
+void Search::setThreads(int threads) {
+  stopHelpers();
+  helpers.clear();
+
+  for (int i = 1; i < threads; ++i) {
+    auto helper = std::make_unique<HelperThread>(tt_helper);
+    helper->search.isHelper = true;
+    helper->search.threadId = i;
+    helper->search.silent = true;
+    helper->search.qsearchChecks = qsearchChecks;
+    helpers.push_back(std::move(helper));
+  }
+}
+
+SearchStats Search::getStats() const {
+  SearchStats total = stats;
+  for (const auto &helper : helpers) {
+    total.add(helper->search.stats);
+  }
+  return total;
+}
+
+long long Search::totalNodes() const {
+  long long total = nodes();
+  for (const auto &helper : helpers) {
+    total += helper->search.nodes();
+  }
+  return total;
+}
 
 /*
-Check if there is any input waiting to be processed.
-The api is different for windows and unix based systems.
+Launch every helper on its own copy of the root position. The flags are
+reset here, before the thread exists, so a stop that arrives right after
+the launch can never be overwritten by the helper starting up.
 */
-void Search::communicate() {
-#ifdef _WIN32
-  static HANDLE stdin_handle = GetStdHandle(STD_INPUT_HANDLE);
-  DWORD available = 0;
-
-  if (PeekNamedPipe(stdin_handle, NULL, 0, NULL, &available, NULL) &&
-      available > 0) {
-    std::string line;
-    std::getline(std::cin, line);
-    if (line == "stop") {
-      stopSearchFlag = true;
-      logMessage("stop");
-    } else if (line == "quit") {
-      logMessage("quit");
-      exit(0);
-    } else if (line == "isready") {
-      std::cout << "readyok" << std::endl;
-      fflush(stdout);
-    } else if (line == "ucinewgame") {
-      tt_helper.clear_table();
-    }
+void Search::startHelpers(int depth) {
+  for (auto &helper : helpers) {
+    helper->board = board;
+    helper->search.stopSearchFlag = false;
+    helper->search.stopRequested = false;
+    helper->search.positionsSearched = 0;
+    helper->search.stats.clear();
+    helper->thread = std::thread(&Search::helperSearch, &helper->search, depth);
+  }
+  helpersRunning = !helpers.empty();
+}
+
+void Search::stopHelpers() {
+  for (auto &helper : helpers) {
+    helper->search.stopSearch();
+  }
+  for (auto &helper : helpers) {
+    if (helper->thread.joinable()) helper->thread.join();
   }
-#else
-  struct pollfd fds[1];
-  fds[0].fd = STDIN_FILENO;
-  fds[0].events = POLLIN;
-
-  if (poll(fds, 1, 0) > 0) {
-    std::string line;
-    std::getline(std::cin, line);
-    if (line == "stop") {
-      stopSearchFlag = true;
-      logMessage("stop");
-    } else if (line == "quit") {
-      logMessage("quit");
-      exit(0);
-    } else if (line == "isready") {
-      std::cout << "readyok" << std::endl;
-      fflush(stdout);
-    } else if (line == "ucinewgame") {
-      tt_helper.clear_table();
+  helpersRunning = false;
+}
+
+/*
+Helper side of Lazy SMP. The helpers run the same iterative deepening as the
+main thread, but their only output is what they leave in the shared TT.
+Odd helpers start one ply deeper so the threads spread over neighbouring
+depths instead of all walking the same tree in lockstep.
+*/
+void Search::helperSearch(int depth) {
+  clearKiller();
+  clearHistory();
+
+  resetAccumulators();
+
+  int previousScore = 0;
+
+  for (int currentDepth = 1 + (threadId & 1); currentDepth <= depth; ++currentDepth) {
+    int bestScore = aspirationSearch(currentDepth, previousScore);
+
+    if (stopSearchFlag) {
+      break;
     }
+
+    previousScore = bestScore;
   }
-#endif
 }
 
-Search::Search(chess::Board &board, TranspositionTable &tt_helper)
-    : board(board), tt_helper(tt_helper) {
-  pvTable.resize(MAX_SEARCH_DEPTH);
-  for (auto &pv : pvTable) {
-    pv.reserve(MAX_SEARCH_DEPTH);
+int Search::aspirationSearch(int depth, int previousScore) {
+  if (depth < ASPIRATION_MIN_DEPTH) {
+    return negamax(depth, -MATE_SCORE, MATE_SCORE, 0, false);
   }
 
-  nnue.load_network();
+  int window = ASPIRATION_WINDOW;
+  int alpha = previousScore - window;
+  int beta = previousScore + window;
+  int bestScore;
+
+  while (true) {
+    bestScore = negamax(depth, alpha, beta, 0, false);
+
+    if (stopSearchFlag) break;
+
+    if (bestScore <= alpha) {
+      // Failed low — widen downward and re-search at the same depth
+      alpha = std::max(bestScore - window, -MATE_SCORE);
+      window *= 2;
+      STAT_INC(aspirationResearches[depth]);
+      if (!silent) sendLine("info string aspiration refail Depth: " + std::to_string(depth) + " Window_size:  " + std::to_string(window));
+    } else if (bestScore >= beta) {
+      // Failed high — widen upward and re-search at the same depth
+      beta = std::min(bestScore + window, MATE_SCORE);
+      window *= 2;
+      STAT_INC(aspirationResearches[depth]);
+      if (!silent) sendLine("info string aspiration refail Depth: " + std::to_string(depth) + " Window_size:  " + std::to_string(window));
+
+    } else {
+      // Landed inside the window — this iteration is done
+      break;
+    }
+  }
+
+  return bestScore;
 }
 
 long long Search::benchSearch(int depth) {
   stopSearchFlag = false;
   positionsSearched = 0;
+  stats.clear();
 
   if (isGameOver(board)) {
-    return positionsSearched;
+    return nodes();
   }
 
   clearKiller();
@@ -85,20 +154,26 @@ long long Search::benchSearch(int depth) {
   chess::Move bestMove = chess::Move::NULL_MOVE;
   int bestScore = 0;
 
-  nnue.refreshAccumulator(board, accStack[0]);
+  resetAccumulators();
 
   for (int currentDepth = 1; currentDepth <= depth; ++currentDepth) {
-    bestScore = negamax(currentDepth, -MATE_SCORE, MATE_SCORE, 0, false);
+    const int score = negamax(currentDepth, -MATE_SCORE, MATE_SCORE, 0, false);
 
-    if (!pvTable[0].empty()) {
-      bestMove = pvTable[0].front();
+    // Node-limited bench: the interrupted iteration is not used.
+    if (stopSearchFlag) {
+      break;
+    }
+
+    bestScore = score;
+    if (pvLength[0] > 0) {
+      bestMove = pvTable[0][0];
     }
   }
 
-  std::cout << "nodes " << positionsSearched << " score " << bestScore
+  std::cout << "nodes " << nodes() << " score " << bestScore
              << " bestmove " << chess::uci::moveToUci(bestMove) << "\n";
 
-  return positionsSearched;
+  return nodes();
 }
 
 void Search::searchBestMove(int depth) {
@@ -106,8 +181,9 @@ void Search::searchBestMove(int depth) {
   if (isGameOver(board)) {
     lastBestMove = chess::Move::NULL_MOVE;
     lastScore = 0;
+    lastNodes = 0;
     const std::string bestmove_str = "bestmove 0000";
-    if (!silent) std::cout << bestmove_str << std::endl;
+    if (!silent) sendLine(bestmove_str);
     logMessage(bestmove_str);
     return;
   }
@@ -116,67 +192,71 @@ void Search::searchBestMove(int depth) {
   clearHistory();
 
   timeManager.start(board);
+  tt_helper.newSearch();
 
   positionsSearched = 0;
+  stats.clear();
 
   chess::Move last_iteration_best_move = chess::Move::NULL_MOVE;
 
   chess::Move bestMove = chess::Move::NULL_MOVE;
-  std::vector<chess::Move> bestLine;
 
-  nnue.refreshAccumulator(board, accStack[0]);
+  resetAccumulators();
 
   int depth_to_search = MAX_SEARCH_DEPTH;
   if (depth > 0) depth_to_search = std::min(depth, MAX_SEARCH_DEPTH);
 
-  int previousScore = 0;
+  chess::Movelist rootMoves;
+  chess::movegen::legalmoves(rootMoves, board);
+  const int lineCount = std::min(multiPV, static_cast<int>(rootMoves.size()));
+  std::vector<RootLine> lines(lineCount);
+
+  startHelpers(depth_to_search);
 
   for (int currentDepth = 1; currentDepth <= depth_to_search; ++currentDepth) {
-    int bestScore;
+    // One pass per line, each excluding the root moves of the lines above
+    // it. A pass cut short by a stop leaves that line as the last depth
+    // had it.
+    int linesDone = 0;
+    for (int k = 0; k < lineCount; ++k) {
+      RootLine &line = lines[k];
+      rootMoveHint = k > 0 && line.length > 0 ? line.pv[0] : chess::Move::NO_MOVE;
+
+      int score = aspirationSearch(currentDepth, line.score);
+
+      if (stopSearchFlag) {
+        break;
+      }
 
-    if (currentDepth < ASPIRATION_MIN_DEPTH) {
-      bestScore = negamax(currentDepth, -MATE_SCORE, MATE_SCORE, 0, false);
-    } else {
-      int window = ASPIRATION_WINDOW;
-      int alpha = previousScore - window;
-      int beta = previousScore + window;
-
-      while (true) {
-        bestScore = negamax(currentDepth, alpha, beta, 0, false);
-
-        if (stopSearchFlag) break;
-
-        if (bestScore <= alpha) {
-          // Failed low — widen downward and re-search at the same depth
-          alpha = std::max(bestScore - window, -MATE_SCORE);
-          window *= 2;
-          if (!silent) std::cout<<"info string aspiration refail Depth: "<<currentDepth << " Window_size:  "<< window << std::endl;
-        } else if (bestScore >= beta) {
-          // Failed high — widen upward and re-search at the same depth
-          beta = std::min(bestScore + window, MATE_SCORE);
-          window *= 2;
-          if (!silent) std::cout<<"info string aspiration refail Depth: "<<currentDepth << " Window_size:  "<< window << std::endl;
-
-        } else {
-          // Landed inside the window — this iteration is done
-          break;
-        }
+      line.score = score;
+      if (pvLength[0] > 0) {
+        line.length = pvLength[0];
+        std::copy_n(pvTable[0], line.length, line.pv);
+        extendPvFromTT(line, currentDepth);
       }
+      if (line.length > 0) excludedRootMoves.push_back(line.pv[0]);
+      ++linesDone;
     }
+    excludedRootMoves.clear();
+    rootMoveHint = chess::Move::NO_MOVE;
 
     if (stopSearchFlag) {
+      // In MultiPV the first pass may have finished before the stop, and
+      // its move is still the best this depth found.
+      if (linesDone > 0 && lines[0].length > 0) bestMove = lines[0].pv[0];
       break;
     }
 
-    previousScore = bestScore;
+    // A later pass can come back higher than an earlier one; report the
+    // lines best first.
+    std::stable_sort(lines.begin(), lines.end(),
+                     [](const RootLine &a, const RootLine &b) { return a.score > b.score; });
 
-    const auto &currentBestLine = pvTable[0];
     bool bestMoveChanged = false;
-    if (!currentBestLine.empty()) {
+    if (lines[0].length > 0) {
       bestMoveChanged = (last_iteration_best_move != chess::Move::NULL_MOVE &&
-                         currentBestLine.front() != last_iteration_best_move);
-      bestMove = currentBestLine.front();
-      bestLine = currentBestLine;
+                         lines[0].pv[0] != last_iteration_best_move);
+      bestMove = lines[0].pv[0];
       last_iteration_best_move = bestMove;
     }
 
@@ -185,62 +265,102 @@ void Search::searchBestMove(int depth) {
 
     // Calculate nodes per second as (nodes / milliseconds) * 1000
     if (elapsedTime > 0) {
-      nps = (positionsSearched * 1000) / elapsedTime;
+      nps = (totalNodes() * 1000) / elapsedTime;
     }
 
     // UCI output
-    if (!silent) printInfoLine(bestScore, bestLine, currentDepth, nps, elapsedTime);
+    if (!silent) {
+      for (int k = 0; k < lineCount; ++k) {
+        printInfoLine(lines[k].score, lines[k].pv, lines[k].length, currentDepth, nps,
+                      elapsedTime, k + 1);
+      }
+    }
 
     // Check if we should stop.
-    if (manageTime(elapsedTime, bestMoveChanged)) {
+    if (manageTime(bestMoveChanged)) {
       break;
     }
   }
 
+  stopHelpers();
+  lastNodes = totalNodes();
+
+  // UCI forbids a bestmove while pondering, even when the search has run
+  // out of depth; hold it until the GUI sends ponderhit or stop.
+  while (timeManager.isPondering() &&
+         !stopRequested.load(std::memory_order_relaxed)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
   if (bestMove == chess::Move::NULL_MOVE) {
-    chess::Movelist moves;
-    chess::movegen::legalmoves(moves, board);
-    bestMove = moves[0];
+    bestMove = rootMoves[0];
   }
 
   lastBestMove = bestMove;
-  lastScore = previousScore;
+  lastScore = lines[0].score;
 
-  const std::string bestmove_str = "bestmove " + chess::uci::moveToUci(bestMove);
+  const RootLine &bestLine = lines[0];
+  std::string bestmove_str = "bestmove " + chess::uci::moveToUci(bestMove);
+  if (bestLine.length >= 2 && bestLine.pv[0] == bestMove) {
+    bestmove_str += " ponder " + chess::uci::moveToUci(bestLine.pv[1]);
+  }
   if (!silent) {
-    std::cout << bestmove_str << std::endl;
+    sendLine(bestmove_str);
   }
   logMessage(bestmove_str);
 }
 
+/*
+A TT cutoff inside a PV node ends the triangular PV there, which in
+MultiPV passes left most lines one move long and the best line without a
+ponder move. The rest of the line is usually still in the table, so it is
+followed on a copy of the board for as long as each stored move is legal,
+up to `depth` moves or the first repetition.
+*/
+void Search::extendPvFromTT(RootLine &line, int depth) {
+  const int maxLength = std::min(depth, MAX_SEARCH_DEPTH - 1);
+  if (line.length == 0 || line.length >= maxLength) return;
+
+  chess::Board position = board;
+  for (int i = 0; i < line.length; ++i) {
+    position.makeMove(line.pv[i]);
+  }
+
+  while (line.length < maxLength && !position.isRepetition(1)) {
+    const chess::Move move = tt_helper.probeMove(position.hash());
+    if (move == chess::Move::NULL_MOVE) break;
+
+    chess::Movelist legal;
+    chess::movegen::legalmoves(legal, position);
+    if (std::find(legal.begin(), legal.end(), move) == legal.end()) break;
+
+    position.makeMove(move);
+    line.pv[line.length++] = move;
+  }
+}
+
 int Search::negamax(int depth, int alpha, int beta, int ply,
                     bool is_null = false) {
-  if (stopSearchFlag || checkHardTimeLimit()) {
+  if (stopped()) {
     return 0;
   }
-  
+
   if (ply >= MAX_SEARCH_DEPTH - 1) {
     return evaluate(ply);
   }
 
-  if ((positionsSearched & 2047) == 0) {
-    communicate();
-    if (stopSearchFlag) {
-      return 0;
-    }
+  // Only the main thread checks the limits; it stops the helpers itself
+  // when the time or the node budget is up.
+  if (!isHelper && checkHardLimits()) {
+    return 0;
   }
 
-  pvTable[ply].clear();
-
-  positionsSearched++;
+  pvLength[ply] = 0;
 
-  if (isGameOver(board)) {
-    if (getGameOverReason(board) == chess::GameResultReason::CHECKMATE)
-      return -MATE_SCORE + ply;
-    else
-      return DRAW_SCORE;
-  }
+  countNode();
 
+  // Checkmate and stalemate are found from the move list generated below;
+  // only the draws that don't need move generation are tested up front.
   if (isSearchDraw(board, ply)) {
     return DRAW_SCORE;
   }
@@ -255,21 +375,41 @@ int Search::negamax(int depth, int alpha, int beta, int ply,
     }
   }
 
+  STAT_INC(interiorNodes);
+
   uint64_t boardhash = board.hash();
   int ttScore = 0;
   chess::Move ttMove = chess::Move::NULL_MOVE;
   int originalAlpha = alpha;
 
-  if (tt_helper.probeTT(boardhash, depth, ttScore, alpha, beta, ttMove, ply) &&
-      ply > 0) {
+  const bool ttCutoff =
+      tt_helper.probeTT(boardhash, depth, ttScore, alpha, beta, ttMove, ply);
+  STAT_INC(ttProbes[std::min(depth, MAX_SEARCH_DEPTH - 1)]);
+  if (ttMove != chess::Move::NULL_MOVE) STAT_INC(ttHits[std::min(depth, MAX_SEARCH_DEPTH - 1)]);
+
+  if (ttCutoff && ply > 0) {
     return ttScore;
   }
 
+  // MultiPV: the root entry has to describe the full move list, so a pass
+  // that excludes moves doesn't store it; each line orders its own previous
+  // move first instead.
+  const bool excludingRootMoves = ply == 0 && !excludedRootMoves.empty();
+  if (ply == 0 && rootMoveHint != chess::Move::NO_MOVE) {
+    ttMove = rootMoveHint;
+  }
+
     // Null move Pruning NMP. Elo: 77.71 +- 30
     if (depth > 3 && !board.inCheck() &&
         board.hasNonPawnMaterial(board.sideToMove()) &&
         depth != MAX_SEARCH_DEPTH && !is_null) {
-      accStack[ply + 1] = accStack[ply]; // Copy current accumulator to next ply
+      STAT_INC(nullMoveTries);
+      uint64_t nullKey = boardhash ^ ZobristKeys::sideToMove();
+      if (board.enpassantSq() != chess::Square::underlying::NO_SQ) {
+        nullKey ^= ZobristKeys::enpassant(board.enpassantSq().file());
+      }
+      tt_helper.prefetch(nullKey);
+      pushAccumulator(ply, chess::Move::NULL_MOVE);
       board.makeNullMove();
       int score = -negamax(depth - 2, -beta, -beta + 1, ply + 1, true);
       board.unmakeNullMove();
@@ -279,6 +419,7 @@ int Search::negamax(int depth, int alpha, int beta, int ply,
     }
 
     if (score >= beta) {
+      STAT_INC(nullMoveCutoffs);
       return beta;
     }
   }
@@ -297,25 +438,31 @@ int Search::negamax(int depth, int alpha, int beta, int ply,
     }
   }
 
-  chess::Movelist moves;
-  chess::movegen::legalmoves(moves, board);
-
-  orderMoves(moves, ttMove, ply, false);
+  MovePicker picker(*this, ttMove, ply, false);
 
   chess::Move bestMove = chess::Move::NULL_MOVE;
   int bestScore = -MATE_SCORE;
+  int movesSearched = 0;
+
+  for (chess::Move move = picker.next(); move != chess::Move::NO_MOVE; move = picker.next()) {
+    if (excludingRootMoves && isExcludedRootMove(move)) {
+      continue;
+    }
 
-  for (int i = 0; i < moves.size(); ++i) {
-    chess::Move move = moves[i];
+    const int i = movesSearched++;
 
     // Capture the flags for later use before making the move
     const bool isCapture = board.isCapture(move);
     const bool isPromotion = move.typeOf() == chess::Move::PROMOTION;
     const bool wasInCheck = board.inCheck();  // side to move, before this move
 
-    // Incremental NNUE update
-    accStack[ply + 1] = accStack[ply];
-    nnue.updateAccumulator(board, move, accStack[ply + 1]);
+    // Children at depth 0 go straight to qsearch, which never probes.
+    if (depth > 1) {
+      tt_helper.prefetch(keyAfter(move));
+    }
+
+    // Incremental NNUE update, applied when the child is evaluated
+    pushAccumulator(ply, move);
 
     board.makeMove(move);
 
@@ -336,8 +483,10 @@ int Search::negamax(int depth, int alpha, int beta, int ply,
       reduction = std::min(reduction, depth - 1);
 
       score = -negamax(depth - 1 - reduction, -beta, -alpha, ply + 1, false);
+      STAT_INC(lmrReductions);
 
       if (score > alpha) {
+        STAT_INC(lmrResearches);
         score = -negamax(depth - 1, -beta, -alpha, ply + 1, false);
       }
     }
@@ -355,15 +504,14 @@ int Search::negamax(int depth, int alpha, int beta, int ply,
       bestScore = score;
       bestMove = move;
 
-      pvTable[ply].clear();
-      pvTable[ply].push_back(move);
-      if (ply + 1 < MAX_SEARCH_DEPTH && !pvTable[ply + 1].empty()) {
-        pvTable[ply].insert(pvTable[ply].end(), pvTable[ply + 1].begin(),
-                            pvTable[ply + 1].end());
-      }
+      updatePv(ply, move);
     }
 
     if (alpha >= beta) {
+      STAT_INC(cutoffs);
+      STAT_ADD(cutoffIndexSum, i);
+      if (i == 0) STAT_INC(firstMoveCutoffs);
+
       if (!board.isCapture(move) && move.typeOf() != chess::Move::PROMOTION) {
         killerMoves[ply][1] = killerMoves[ply][0];
         killerMoves[ply][0] = move;
@@ -373,11 +521,19 @@ int Search::negamax(int depth, int alpha, int beta, int ply,
         historyTable[board.sideToMove()][move.from().index()]
                     [move.to().index()] = bonus;
       }
-      tt_helper.storeTT(boardhash, depth, score, TTEntryType::LOWER, move, ply);
+      if (!excludingRootMoves) {
+        tt_helper.storeTT(boardhash, depth, score, TTEntryType::LOWER, move, ply);
+      }
       return score;  // beta cuttof
     }
   }
 
+  // The picker yields every legal move, so nothing searched means no legal
+  // moves: checkmate or stalemate.
+  if (movesSearched == 0) {
+    return board.inCheck() ? -MATE_SCORE + ply : DRAW_SCORE;
+  }
+
   TTEntryType entryType;
   if (bestScore <= originalAlpha) {
     entryType = TTEntryType::UPPER;
@@ -387,11 +543,73 @@ int Search::negamax(int depth, int alpha, int beta, int ply,
     entryType = TTEntryType::EXACT;
   }
 
-  tt_helper.storeTT(boardhash, depth, bestScore, entryType, bestMove, ply);
+  if (!excludingRootMoves) {
+    tt_helper.storeTT(boardhash, depth, bestScore, entryType, bestMove, ply);
+  }
 
   return bestScore;
 }
 
+uint64_t Search::keyAfter(chess::Move move) const {
+  using chess::PieceType;
+
+  const chess::Color us = board.sideToMove();
+  const chess::Square from = move.from();
+  const chess::Square to = move.to();
+  const chess::Piece piece = board.at(from);
+
+  uint64_t key = board.hash() ^ ZobristKeys::sideToMove();
+
+  if (board.enpassantSq() != chess::Square::underlying::NO_SQ) {
+    key ^= ZobristKeys::enpassant(board.enpassantSq().file());
+  }
+
+  // Castling rights lost by a king move or by a rook leaving its corner.
+  // A rook captured in its corner is ignored.
+  chess::Board::CastlingRights rights = board.castlingRights();
+  if (piece.type() == PieceType::KING && rights.has(us)) {
+    key ^= ZobristKeys::castling(rights.hashIndex());
+    rights.clear(us);
+    key ^= ZobristKeys::castling(rights.hashIndex());
+  } else if (piece.type() == PieceType::ROOK && chess::Square::back_rank(from, us)) {
+    const auto side = chess::Board::CastlingRights::closestSide(from, board.kingSq(us));
+    if (rights.getRookFile(us, side) == from.file()) {
+      key ^= ZobristKeys::castlingIndex(rights.clear(us, side));
+    }
+  }
+
+  if (move.typeOf() == chess::Move::CASTLING) {
+    const bool kingSide = to > from;
+    const chess::Piece rook = board.at(to);
+    return key ^ ZobristKeys::piece(piece, from) ^
+           ZobristKeys::piece(piece, chess::Square::castling_king_square(kingSide, us)) ^
+           ZobristKeys::piece(rook, to) ^
+           ZobristKeys::piece(rook, chess::Square::castling_rook_square(kingSide, us));
+  }
+
+  key ^= ZobristKeys::piece(piece, from);
+
+  const chess::Piece captured = board.at(to);
+  if (captured != chess::Piece::NONE) {
+    key ^= ZobristKeys::piece(captured, to);
+  } else if (move.typeOf() == chess::Move::ENPASSANT) {
+    key ^= ZobristKeys::piece(chess::Piece(PieceType::PAWN, ~us), to.ep_square());
+  }
+
+  if (move.typeOf() == chess::Move::PROMOTION) {
+    return key ^ ZobristKeys::piece(chess::Piece(move.promotionType(), us), to);
+  }
+
+  // A double push sets the en passant square if an enemy pawn attacks it
+  // (makeMove also checks that the capture would be legal; we don't).
+  if (piece.type() == PieceType::PAWN && chess::Square::value_distance(to, from) == 16 &&
+      (chess::attacks::pawn(us, to.ep_square()) & board.pieces(PieceType::PAWN, ~us))) {
+    key ^= ZobristKeys::enpassant(to.file());
+  }
+
+  return key ^ ZobristKeys::piece(piece, to);
+}
+
 /*
 Returns a bitboard of every piece, either color, that attacks `sq` given a
 (possibly hypothetical) occupancy bitboard. Used by see() to walk through a
@@ -470,6 +688,8 @@ bitboard instead. Handles en passant and promotion.
 int Search::see(chess::Move move) {
   using namespace chess;
 
+  STAT_INC(seeCalls);
+
   const Square from = move.from();
   const Square to = move.to();
 
@@ -535,64 +755,9 @@ int Search::see(chess::Move move) {
 }
 
 
-/* Order moves based on their priority */
-void Search::orderMoves(chess::Movelist &moves, chess::Move ttMove, int ply,
-                        bool isQuiescence) {
-  const chess::Move killer1 = killerMoves[ply][0];
-  const chess::Move killer2 = killerMoves[ply][1];
-
-  for (chess::Move &move : moves) {
-    int score = 0;
-
-    if (ttMove != chess::Move::NULL_MOVE && move == ttMove) {
-      score += 10000;
-    }
-
-    // Order captures by SEE instead of raw MVV-LVA, so a capture that
-    // loses material (e.g. QxP defended by a pawn) doesn't get ranked
-    // above quiet moves just because it grabs a piece.
-    if (board.isCapture(move)) {
-      int seeValue = see(move);
-      if (seeValue >= 0) {
-        score += 8000 + seeValue;  // winning/equal captures: above killers
-      } else {
-        score += 1000 + seeValue;  // losing captures: still above most quiets, below killers
-      }
-    } else {
-      if (move == killer1) {
-        score += 500;  // High score for primary killer
-      } else if (move == killer2) {
-        score += 400;  // Slightly lower score for secondary killer
-      }
-
-      // History score
-      score += historyTable[board.sideToMove()][move.from().index()]
-                           [move.to().index()];
-    }
-
-    // Prioritize promotions
-    if (move.typeOf() == chess::Move::PROMOTION) {
-      if (move.promotionType() == chess::QUEEN)
-        score += 900;
-      else if (move.promotionType() == chess::ROOK)
-        score += 500;
-      else if (move.promotionType() == chess::BISHOP)
-        score += 320;
-      else if (move.promotionType() == chess::KNIGHT)
-        score += 300;
-    }
-
-    move.setScore(static_cast<int16_t>(score));
-  }
-
-  // Sort moves in descending order of score
-  std::sort(moves.begin(), moves.end(),
-            [](const chess::Move &a, const chess::Move &b) { return a.score() > b.score(); });
-}
-
 /* Reach a stable quiet pos before evaluating */
-int Search::qsearch(int alpha, int beta, int ply) {
-  if (checkHardTimeLimit()) {
+int Search::qsearch(int alpha, int beta, int ply, int qsDepth) {
+  if (stopped()) {
     return 0;
   }
 
@@ -600,21 +765,12 @@ int Search::qsearch(int alpha, int beta, int ply) {
     return evaluate(ply);
   }
 
-  if ((positionsSearched & 2047) == 0) {
-    communicate();
-  }
-
-  if (stopSearchFlag) {
+  if (!isHelper && checkHardLimits()) {
     return 0;
   }
-  positionsSearched++;
 
-  if (isGameOver(board)) {
-    if (getGameOverReason(board) == chess::GameResultReason::CHECKMATE)
-      return -MATE_SCORE + ply;
-    else
-      return DRAW_SCORE;
-  }
+  countNode();
+  STAT_INC(qsearchNodes);
 
   if (isSearchDraw(board, ply)) {
     return DRAW_SCORE;
@@ -622,13 +778,12 @@ int Search::qsearch(int alpha, int beta, int ply) {
 
   const bool inCheck = board.inCheck();
 
-  int standPat = 0;
   if (!inCheck) {
     // Stand-pat is only sound when not in check: it assumes "doing
     // nothing" is a reasonable option, which isn't true when you're in
     // check and forced to respond somehow.
 
-     int standPat = evaluate(ply);
+    int standPat = evaluate(ply);
 
     if (standPat >= beta) {
       return beta;
@@ -636,34 +791,23 @@ int Search::qsearch(int alpha, int beta, int ply) {
     alpha = std::max(alpha, standPat);
   }
 
-  chess::Movelist allMoves;
-  chess::movegen::legalmoves<chess::movegen::MoveGenType::ALL>(allMoves, board);
+  // The picker only generates captures here, never the full move list.
+  // Captures that lose material by SEE never come out of it, standing pat
+  // already covers "this position is fine without capturing". In check it
+  // hands out every evasion instead. Quiet checks are limited to the first
+  // qsearch ply so check sequences can't run away.
+  MovePicker picker(*this, chess::Move::NULL_MOVE, ply, true,
+                    qsearchChecks && qsDepth == 0 && !inCheck);
+  int movesSearched = 0;
 
-  chess::Movelist moves;
-  for (chess::Move m : allMoves) {
-    if (inCheck || board.isCapture(m) || m.typeOf() == chess::Move::PROMOTION) {
-      moves.add(m);
-    }
-  }
-
-  orderMoves(moves, chess::Move::NULL_MOVE, ply, true);
-
-  for (chess::Move move : moves) {
-    // SEE pruning: skip captures that lose material outright. Standing
-    // pat already covers "this position is fine without capturing", so
-    // there's no point recursing into a capture that hands over material
-    // for nothing. Skipped while in check, since qsearch doesn't generate
-    // evasions here and every capture may be forced.
-    if (!inCheck && board.isCapture(move) && see(move) < 0) {
-      continue;
-    }
+  for (chess::Move move = picker.next(); move != chess::Move::NO_MOVE; move = picker.next()) {
+    movesSearched++;
 
-    // Incremental NNUE update
-    accStack[ply + 1] = accStack[ply];
-    nnue.updateAccumulator(board, move, accStack[ply + 1]);
+    // Incremental NNUE update, applied when the child is evaluated
+    pushAccumulator(ply, move);
 
     board.makeMove(move);
-    int score = -qsearch(-beta, -alpha, ply + 1);
+    int score = -qsearch(-beta, -alpha, ply + 1, qsDepth - 1);
     board.unmakeMove(move);
 
     alpha = std::max(alpha, score);
@@ -672,9 +816,28 @@ int Search::qsearch(int alpha, int beta, int ply) {
     }
   }
 
+  // Only evasions are complete lists, so only checkmate can be told apart
+  // here; a quiet position with no captures just keeps its stand-pat score.
+  if (inCheck && movesSearched == 0) {
+    return -MATE_SCORE + ply;
+  }
+
   return alpha;
 }
 
+/* PV at `ply` becomes `move` followed by the child's PV. */
+void Search::updatePv(int ply, chess::Move move) {
+  pvTable[ply][0] = move;
+
+  int childLength = ply + 1 < MAX_SEARCH_DEPTH ? pvLength[ply + 1] : 0;
+  childLength = std::min(childLength, MAX_SEARCH_DEPTH - 1);
+
+  for (int i = 0; i < childLength; ++i) {
+    pvTable[ply][i + 1] = pvTable[ply + 1][i];
+  }
+  pvLength[ply] = childLength + 1;
+}
+
 // Heuristics
 void Search::clearKiller() {
   for (int i = 0; i < MAX_SEARCH_DEPTH; ++i) {
@@ -710,24 +873,47 @@ int Search::getPieceValue(chess::Piece piece) {
   }
 }
 
-int Search::evaluate(int ply) { return nnue.evaluate(board.sideToMove(), accStack[ply]); }
+int Search::evaluate(int ply) {
+  materializeAccumulator(ply);
+  return nnue.evaluate(board.sideToMove(), accStack[ply]);
+}
 
-bool Search::isGameOver(const chess::Board &board) {
-  auto result = board.isGameOver();
-  return result.second != chess::GameResult::NONE;
+void Search::resetAccumulators() {
+  nnue.refreshAccumulator(board, accStack[0]);
+  accComputed[0] = true;
+  accUpdatesQueued = 0;
+  accUpdatesApplied = 0;
 }
 
-chess::GameResultReason Search::getGameOverReason(const chess::Board &board) {
+// accComputed[0] is always set, so the walk back ends at the root at worst.
+void Search::materializeAccumulator(int ply) {
+  int computed = ply;
+  while (!accComputed[computed]) --computed;
+
+  for (int p = computed + 1; p <= ply; ++p) {
+    nnue.applyDelta(accDelta[p], accStack[p - 1], accStack[p]);
+    accComputed[p] = true;
+    ++accUpdatesApplied;
+  }
+}
+
+bool Search::isGameOver(const chess::Board &board) {
   auto result = board.isGameOver();
-  return result.first;
+  return result.second != chess::GameResult::NONE;
 }
 
+/*
+Draws that can be decided without generating moves: repetition, insufficient
+material (a popcount and a few bitboard tests) and the 50-move rule. The
+50-move rule only falls back to move generation once the clock reaches 100,
+to let a checkmate on that move take priority.
+*/
 bool Search::isSearchDraw(const chess::Board &board, int ply) {
   if (ply == 0) {
     return false;
   }
 
-  if (board.isRepetition(1)) {
+  if (board.isRepetition(1) || board.isInsufficientMaterial()) {
     return true;
   }
 
@@ -735,12 +921,15 @@ bool Search::isSearchDraw(const chess::Board &board, int ply) {
          board.getHalfMoveDrawType().second == chess::GameResult::DRAW;
 }
 
-void Search::printInfoLine(int bestScore, std::vector<chess::Move> bestLine,
+void Search::printInfoLine(int bestScore, const chess::Move *bestLine, int bestLineLength,
                            int currentDepth, long long nps,
-                           long long elapsedTime) {
+                           long long elapsedTime, int multipvIndex) {
   std::stringstream info_ss;
-  info_ss << "info depth " << currentDepth << " nodes " << positionsSearched
-          << " time " << elapsedTime << " nps " << nps << " score ";
+  info_ss << "info depth " << currentDepth;
+  if (multiPV > 1) info_ss << " multipv " << multipvIndex;
+  info_ss << " nodes " << totalNodes()
+          << " time " << elapsedTime << " nps " << nps
+          << " hashfull " << tt_helper.hashfull() << " score ";
 
   if (std::abs(bestScore) > (MATE_SCORE - MATE_THRESHHOLD)) {
     int movesToMate;
@@ -756,11 +945,11 @@ void Search::printInfoLine(int bestScore, std::vector<chess::Move> bestLine,
     info_ss << "cp " << bestScore << " pv ";
   }
 
-  for (const auto &move : bestLine) {
-    info_ss << move << " ";
+  for (int i = 0; i < bestLineLength; ++i) {
+    info_ss << bestLine[i] << " ";
   }
   std::string info_str = info_ss.str();
-  std::cout << info_str << std::endl;
+  sendLine(info_str);
   logMessage(info_str);
 }
 
@@ -778,12 +967,32 @@ void Search::logMessage(const std::string &message) {
   }
 }
 
-bool Search::manageTime(long long elapsedTime, bool bestMoveChanged) {
-  return timeManager.shouldStopAfterIteration(elapsedTime, bestMoveChanged);
+bool Search::manageTime(bool bestMoveChanged) {
+  const bool timeUp = timeManager.shouldStopAfterIteration(bestMoveChanged);
+  return timeUp || (softNodeLimit > 0 && totalNodes() >= softNodeLimit);
 }
 
-bool Search::checkHardTimeLimit() {
-  if (timeManager.hardLimitReached()) {
+void Search::ponderhit() {
+  timeManager.ponderhit();
+}
+
+// Alone, the node budget is checked on every node so `go nodes` stops
+// exactly. With helpers searching, summing their counters reads every
+// thread's cache line, so it is only done on the 2048-node clock poll; the
+// search may overshoot the budget by up to that many nodes per thread.
+// bench never starts the helpers, so it always takes the exact path.
+bool Search::checkHardLimits() {
+  const bool poll = (nodes() & 2047) == 0;
+  bool outOfNodes = false;
+  if (nodeLimit > 0) {
+    if (!helpersRunning) {
+      outOfNodes = nodes() >= nodeLimit;
+    } else if (poll) {
+      outOfNodes = totalNodes() >= nodeLimit;
+    }
+  }
+
+  if (outOfNodes || (poll && timeManager.hardLimitReached())) {
     stopSearchFlag = true;
     return true;
   }
@@ -796,4 +1005,6 @@ long long Search::getElapsedTime() {
 
 void Search::setTimeValues(const GoOptions& options) {
   timeManager.setTimeValues(options);
+  nodeLimit = options.nodes;
+  softNodeLimit = options.softNodes;
 }
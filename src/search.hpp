@@ -1,6 +1,10 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "utils.hpp"
@@ -8,15 +12,34 @@
 #include "constants.hpp"
 #include "tt.hpp"
 #include "nnue.hpp"
+#include "movepicker.hpp"
+#include "search_stats.hpp"
 #include "time_manager.hpp"
 
+struct HelperThread;
+
 class Search {
  public:
   Search(chess::Board &board, TranspositionTable &tt_helper);
+  ~Search();
 
   void searchBestMove(int depth = 0);
 
-  void stopSearch() { stopSearchFlag = true; }
+  // Safe to call from any thread while a search is running. The request
+  // stays set until resetStop(), so a stop that lands before the search
+  // thread gets going isn't lost.
+  void stopSearch() { stopRequested = true; }
+  void resetStop() { stopRequested = false; }
+
+  // The opponent played the move we were pondering on: keep searching, but
+  // on the clock from now on. Safe to call from the UCI thread.
+  void ponderhit();
+
+  // Lazy SMP: total number of threads searching on each `go`, including
+  // this one. The extra threads are helpers that share our TT and nothing
+  // else; only this (main) thread talks UCI and picks the bestmove.
+  void setThreads(int threads);
+  int getThreads() const { return static_cast<int>(helpers.size()) + 1; }
 
   void setTimeValues(const GoOptions& options);
 
@@ -24,7 +47,12 @@ class Search {
 
   void toggleLogs() { storeLogs = !storeLogs; }
 
-  void communicate();
+  // Also search quiet checking moves at the first qsearch ply.
+  void setQsearchChecks(bool enabled);
+
+  // Number of best root lines to report. Only the main thread uses it; the
+  // helpers keep searching the full root.
+  void setMultiPV(int lines) { multiPV = lines; }
 
   long long benchSearch(int depth);
 
@@ -35,22 +63,93 @@ class Search {
   void setSilent(bool s) { silent = s; }
   int getLastScore() const { return lastScore; }
   chess::Move getLastBestMove() const { return lastBestMove; }
+  long long getLastNodes() const { return lastNodes; }
+
+  // Accumulator updates queued by the moves made in the last search, and
+  // how many of them evaluate() actually had to compute. This thread only.
+  long long getAccUpdatesQueued() const { return accUpdatesQueued; }
+  long long getAccUpdatesApplied() const { return accUpdatesApplied; }
+
+  // Counters for the last search, summed over the helpers. Always zero
+  // unless built with INDUS_SEARCH_STATS.
+  SearchStats getStats() const;
 
  private:
   bool silent = false;
   int lastScore = 0;
+  long long lastNodes = 0;
   chess::Move lastBestMove = chess::Move::NULL_MOVE;
 
   chess::Board &board;
 
   TranspositionTable &tt_helper;
 
+  // Accumulators are updated lazily. Making a move only records its
+  // feature delta in accDelta[ply + 1]; accStack[ply] is valid only while
+  // accComputed[ply] is set, and evaluate(ply) computes the missing plies
+  // from the nearest computed ancestor. Children that are cut off by the
+  // TT, drawn or pruned before evaluation never pay for an update.
   NNUE::Accumulator accStack[MAX_SEARCH_DEPTH];
-  NNUE::Network nnue;
-
+  NNUE::FeatureDelta accDelta[MAX_SEARCH_DEPTH];
+  bool accComputed[MAX_SEARCH_DEPTH] = {};
+  const NNUE::Network &nnue;  // the process-wide net, shared by all threads
+
+  long long accUpdatesQueued = 0;
+  long long accUpdatesApplied = 0;
+
+  // Root of a new search: full refresh of accStack[0].
+  void resetAccumulators();
+
+  // Ply `ply + 1` is reached by `move` (board still before it), or by a
+  // null move when `move` is NULL_MOVE.
+  void pushAccumulator(int ply, chess::Move move) {
+    accDelta[ply + 1] = move == chess::Move::NULL_MOVE ? NNUE::FeatureDelta{}
+                                                       : NNUE::Network::moveDelta(board, move);
+    accComputed[ply + 1] = false;
+    ++accUpdatesQueued;
+  }
+
+  void materializeAccumulator(int ply);
+
+  // stopRequested comes from outside (UCI thread, or the main thread
+  // stopping its helpers); stopSearchFlag is this search's own record that
+  // it has to unwind, set by either a request or a limit.
+  std::atomic<bool> stopRequested{false};
   bool stopSearchFlag = false;
 
-  long long positionsSearched = 0;
+  bool stopped() {
+    if (stopRequested.load(std::memory_order_relaxed)) stopSearchFlag = true;
+    return stopSearchFlag;
+  }
+
+  // Written only by the owning thread; atomic so the main thread can sum
+  // helper node counts for the info line while they are still searching.
+  std::atomic<long long> positionsSearched{0};
+
+  void countNode() {
+    positionsSearched.store(positionsSearched.load(std::memory_order_relaxed) + 1,
+                            std::memory_order_relaxed);
+  }
+  long long nodes() const { return positionsSearched.load(std::memory_order_relaxed); }
+  long long totalNodes() const;
+
+  SearchStats stats;
+
+  void countMoveGen() { STAT_INC(moveGens); }
+
+  friend class MovePicker;
+
+  // Helpers never poll stdin or print; they just deepen until stopped.
+  bool isHelper = false;
+  int threadId = 0;
+  std::vector<std::unique_ptr<HelperThread>> helpers;
+  // True from startHelpers until stopHelpers. Outside a `go` the helper
+  // counters still hold the last search's nodes and must not be summed.
+  bool helpersRunning = false;
+
+  void startHelpers(int depth);
+  void stopHelpers();
+  void helperSearch(int depth);
 
   // Heuristics
   chess::Move killerMoves[MAX_SEARCH_DEPTH][2];
@@ -62,20 +161,53 @@ class Search {
   void clearHistory();
 
   // Search
-  std::vector<std::vector<chess::Move>> pvTable;
+  // Triangular PV table: pvTable[ply] holds the line found from `ply`
+  // onwards and pvLength[ply] how many moves of it are valid. Fixed size so
+  // the search never touches the heap when a move raises the score.
+  chess::Move pvTable[MAX_SEARCH_DEPTH][MAX_SEARCH_DEPTH];
+  int pvLength[MAX_SEARCH_DEPTH] = {};
+
+  void updatePv(int ply, chess::Move move);
+
+  int aspirationSearch(int depth, int previousScore);
+
+  // MultiPV: line k is found by searching the root without the moves of
+  // lines 1..k-1. Each line keeps its own score for the aspiration window
+  // and its own move, which is tried first at the root on the next depth.
+  struct RootLine {
+    chess::Move pv[MAX_SEARCH_DEPTH];
+    int length = 0;
+    int score = 0;
+  };
+
+  // Appends the TT's moves to a line cut short by a TT cutoff.
+  void extendPvFromTT(RootLine &line, int depth);
+
+  int multiPV = 1;
+  std::vector<chess::Move> excludedRootMoves;
+  chess::Move rootMoveHint = chess::Move::NO_MOVE;
+
+  bool isExcludedRootMove(chess::Move move) const {
+    return std::find(excludedRootMoves.begin(), excludedRootMoves.end(), move) !=
+           excludedRootMoves.end();
+  }
 
   int negamax(int depth, int alpha, int beta, int ply, bool is_null);
 
-  int qsearch(int alpha, int beta, int ply);
+  // Zobrist key after `move`, without making it. Follows makeMove except
+  // for a few rare cases (see search.cpp), so it is occasionally off; it is
+  // only used to prefetch the child's TT bucket.
+  uint64_t keyAfter(chess::Move move) const;
 
-  void orderMoves(chess::Movelist &moves, chess::Move tt_move, int ply, bool isQuiescence);
+  // qsDepth is 0 on entry from negamax and goes negative from there.
+  int qsearch(int alpha, int beta, int ply, int qsDepth = 0);
+
+  bool qsearchChecks = false;
 
   int evaluate(int ply);
 
   bool isGameOver(const chess::Board &board);
 
-  chess::GameResultReason getGameOverReason(const chess::Board &board);
-
   bool isSearchDraw(const chess::Board &board, int ply);
 
   int getPieceValue(chess::Piece piece);
@@ -86,13 +218,26 @@ class Search {
   chess::Square popLeastValuableAttacker(chess::Bitboard &attackers, chess::Color color,
                                          chess::PieceType &outType) const;
 
-  void printInfoLine(int eval, std::vector<chess::Move> pv, int currentDepth,
-                     long long nps, long long elapsedTime);
+  void printInfoLine(int eval, const chess::Move *pv, int pvLength, int currentDepth,
+                     long long nps, long long elapsedTime, int multipvIndex = 1);
 
   bool storeLogs = false;
 
   TimeManager timeManager;
-  bool manageTime(long long elapsedTime, bool bestMoveChanged);
-  bool checkHardTimeLimit();
+  bool manageTime(bool bestMoveChanged);
+  bool checkHardLimits();
+
+  long long nodeLimit = 0;
+  long long softNodeLimit = 0;
   long long getElapsedTime();
 };
+
+// A Lazy SMP helper owns a copy of the root board and its own Search, so
+// accStack, killers, history and the PV table are all per thread.
+struct HelperThread {
+  chess::Board board;
+  Search search;
+  std::thread thread;
+
+  explicit HelperThread(TranspositionTable &tt) : search(board, tt) {}
+};
@@ -0,0 +1,97 @@
+#include "search_stats.hpp"
+
+#include <iomanip>
+
+namespace {
+
+double ratio(long long part, long long whole) {
+  return whole > 0 ? static_cast<double>(part) / whole : 0.0;
+}
+
+// Depth-indexed arrays are printed up to the deepest non-zero entry.
+int usedDepths(const long long *values) {
+  int used = 0;
+  for (int d = 0; d < MAX_SEARCH_DEPTH; ++d) {
+    if (values[d] != 0) used = d + 1;
+  }
+  return used;
+}
+
+void dumpArray(std::ostream &out, const char *name, const long long *values) {
+  out << ",\"" << name << "\":[";
+  const int used = usedDepths(values);
+  for (int d = 0; d < used; ++d) {
+    out << (d ? "," : "") << values[d];
+  }
+  out << "]";
+}
+
+}  // namespace
+
+void SearchStats::add(const SearchStats &other) {
+  interiorNodes += other.interiorNodes;
+  qsearchNodes += other.qsearchNodes;
+  cutoffs += other.cutoffs;
+  firstMoveCutoffs += other.firstMoveCutoffs;
+  cutoffIndexSum += other.cutoffIndexSum;
+  nullMoveTries += other.nullMoveTries;
+  nullMoveCutoffs += other.nullMoveCutoffs;
+  lmrReductions += other.lmrReductions;
+  lmrResearches += other.lmrResearches;
+  moveGens += other.moveGens;
+  seeCalls += other.seeCalls;
+
+  for (int d = 0; d < MAX_SEARCH_DEPTH; ++d) {
+    aspirationResearches[d] += other.aspirationResearches[d];
+    ttProbes[d] += other.ttProbes[d];
+    ttHits[d] += other.ttHits[d];
+  }
+}
+
+void SearchStats::print(std::ostream &out) const {
+  const long long nodes = interiorNodes + qsearchNodes;
+
+  out << std::fixed << std::setprecision(3);
+  out << "nodes " << nodes << " interior " << interiorNodes << " qsearch "
+      << qsearchNodes << " (" << ratio(qsearchNodes, nodes) << ")\n";
+  out << "cutoffs " << cutoffs << " first move " << ratio(firstMoveCutoffs, cutoffs)
+      << " avg index " << ratio(cutoffIndexSum, cutoffs) << "\n";
+  out << "null move tries " << nullMoveTries << " cutoffs " << nullMoveCutoffs
+      << " (" << ratio(nullMoveCutoffs, nullMoveTries) << ")\n";
+  out << "lmr reductions " << lmrReductions << " re-searches " << lmrResearches
+      << " (" << ratio(lmrResearches, lmrReductions) << ")\n";
+  out << "movegens " << moveGens << " (" << ratio(moveGens, nodes) << "/node) see "
+      << seeCalls << " (" << ratio(seeCalls, nodes) << "/node)\n";
+
+  out << "aspiration re-searches by depth:";
+  const int aspirationDepths = usedDepths(aspirationResearches);
+  for (int d = 1; d < aspirationDepths; ++d) {
+    out << " " << d << ":" << aspirationResearches[d];
+  }
+  out << "\n";
+
+  out << "tt hit rate by depth:";
+  const int ttDepths = usedDepths(ttProbes);
+  for (int d = 0; d < ttDepths; ++d) {
+    if (ttProbes[d] == 0) continue;
+    out << " " << d << ":" << ratio(ttHits[d], ttProbes[d]);
+  }
+  out << "\n";
+  out << std::defaultfloat;
+}
+
+void SearchStats::dump(std::ostream &out) const {
+  out << "searchstats {\"interior_nodes\":" << interiorNodes
+      << ",\"qsearch_nodes\":" << qsearchNodes << ",\"cutoffs\":" << cutoffs
+      << ",\"first_move_cutoffs\":" << firstMoveCutoffs
+      << ",\"cutoff_index_sum\":" << cutoffIndexSum
+      << ",\"null_move_tries\":" << nullMoveTries
+      << ",\"null_move_cutoffs\":" << nullMoveCutoffs
+      << ",\"lmr_reductions\":" << lmrReductions
+      << ",\"lmr_researches\":" << lmrResearches << ",\"movegens\":" << moveGens
+      << ",\"see_calls\":" << seeCalls;
+  dumpArray(out, "aspiration_researches", aspirationResearches);
+  dumpArray(out, "tt_probes", ttProbes);
+  dumpArray(out, "tt_hits", ttHits);
+  out << "}\n";
+}
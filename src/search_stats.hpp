@@ -0,0 +1,55 @@
+#pragma once
+
+#include <ostream>
+
+#include "constants.hpp"
+
+// Counters describing how a search spent its nodes: where they went, how
+// well moves were ordered and how often the pruning tricks paid off. They
+// are only collected when built with INDUS_SEARCH_STATS (the CMake option
+// INDUS_ENABLE_SEARCH_STATS); otherwise the STAT_* macros below expand to
+// nothing and the search carries no counting code at all.
+struct SearchStats {
+  long long interiorNodes = 0;
+  long long qsearchNodes = 0;
+
+  // Beta cutoffs in negamax, and the index of the move that caused them.
+  long long cutoffs = 0;
+  long long firstMoveCutoffs = 0;
+  long long cutoffIndexSum = 0;
+
+  long long nullMoveTries = 0;
+  long long nullMoveCutoffs = 0;
+
+  long long lmrReductions = 0;
+  long long lmrResearches = 0;
+
+  long long moveGens = 0;
+  long long seeCalls = 0;
+
+  // Indexed by iteration depth.
+  long long aspirationResearches[MAX_SEARCH_DEPTH] = {};
+
+  // Indexed by remaining depth at the probing node.
+  long long ttProbes[MAX_SEARCH_DEPTH] = {};
+  long long ttHits[MAX_SEARCH_DEPTH] = {};
+
+  void clear() { *this = SearchStats{}; }
+  void add(const SearchStats &other);
+
+  // Human-readable report for the `searchstats` command.
+  void print(std::ostream &out) const;
+
+  // The same counters as a single JSON line, for scripts reading `bench`.
+  void dump(std::ostream &out) const;
+};
+
+#ifdef INDUS_SEARCH_STATS
+constexpr bool SEARCH_STATS_ENABLED = true;
+#define STAT_INC(field) (++stats.field)
+#define STAT_ADD(field, n) (stats.field += (n))
+#else
+constexpr bool SEARCH_STATS_ENABLED = false;
+#define STAT_INC(field) ((void)0)
+#define STAT_ADD(field, n) ((void)0)
+#endif
@@ -85,6 +85,9 @@ void TimeManager::setTimeValues(const GoOptions& options) {
   movetime = options.movetime;
 
   timeEnabled = options.hasTimeLimit();
+
+  pondering = options.ponder;
+  ponderhitAt = 0;
 }
 
 void TimeManager::start(const chess::Board& board) {
@@ -95,15 +98,17 @@ void TimeManager::start(const chess::Board& board) {
   startTime = std::chrono::steady_clock::now();
 }
 
-bool TimeManager::shouldStopAfterIteration(long long elapsedTime, bool bestMoveChanged) {
+bool TimeManager::shouldStopAfterIteration(bool bestMoveChanged) {
   if (bestMoveChanged) {
     moveChanges++;
   }
 
-  if (!timeEnabled) {
+  if (!timeEnabled || isPondering()) {
     return false;
   }
 
+  const long long elapsedTime = budgetElapsedMs();
+
   if (elapsedTime >= softTime) {
     if (moveChanges >= 2 && elapsedTime < hardTime / 3) {
       softTime += softTime * 0.3;
@@ -116,7 +121,25 @@ bool TimeManager::shouldStopAfterIteration(long long elapsedTime, bool bestMoveC
 }
 
 bool TimeManager::hardLimitReached() const {
-  return timeEnabled && elapsedMs() >= hardTime;
+  return timeEnabled && !isPondering() && budgetElapsedMs() >= hardTime;
+}
+
+void TimeManager::ponderhit() {
+  ponderhitAt = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch())
+                    .count();
+  pondering = false;
+}
+
+long long TimeManager::budgetElapsedMs() const {
+  const long long startMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                startTime.time_since_epoch())
+                                .count();
+  const long long nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                              std::chrono::steady_clock::now().time_since_epoch())
+                              .count();
+  // A ponderhit that raced ahead of start() counts as happening at start.
+  return nowMs - std::max(startMs, ponderhitAt.load(std::memory_order_relaxed));
 }
 
 long long TimeManager::elapsedMs() const {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
 
 #include "chess.hpp"
@@ -19,16 +20,30 @@ class TimeManager {
   // Call after each completed iterative-deepening iteration.
   // bestMoveChanged should be true if the best move differs from the
   // previous iteration's best move. Returns true if the search should stop.
-  bool shouldStopAfterIteration(long long elapsedTime, bool bestMoveChanged);
+  bool shouldStopAfterIteration(bool bestMoveChanged);
 
   // Cheap check used inside negamax/qsearch to enforce the hard cutoff.
   bool hardLimitReached() const;
 
   long long elapsedMs() const;
 
+  // `go ponder`: the budget is computed as usual but not spent until the
+  // opponent plays the expected move. Called from the UCI thread.
+  void ponderhit();
+  bool isPondering() const { return pondering.load(std::memory_order_relaxed); }
+
  private:
   bool timeEnabled = false;
 
+  // Set before the search thread starts, cleared by ponderhit() on the UCI
+  // thread; ponderhitAt is the steady_clock time of that ponderhit in ms.
+  std::atomic<bool> pondering{false};
+  std::atomic<long long> ponderhitAt{0};
+
+  // Time the budget has actually been running: since the search started,
+  // or since ponderhit if it began as a ponder search.
+  long long budgetElapsedMs() const;
+
   long long softTime = 0;
   long long hardTime = 0;
   int moveChanges = 0;
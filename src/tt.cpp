@@ -1,71 +1,470 @@
 #include "tt.hpp"
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <malloc.h>
+#endif
+
 #include "constants.hpp"
 
-size_t TranspositionTable::entriesForMB(size_t mb) {
-  if (mb < 1) mb = 1;
-  size_t bytes = mb * 1024ULL * 1024ULL;
-  size_t entries = bytes / sizeof(TTEntry);
+namespace {
+
+// Scores are kept in 16 bits. Normal evals fit as they are; a mate score
+// is stored as its distance below TT_MATE so the ply count survives.
+constexpr int TT_MATE = 32000;
+constexpr int TT_MATE_BAND = TT_MATE - MATE_THRESHHOLD;
+constexpr int MATE_BAND = MATE_SCORE - MATE_THRESHHOLD;
+
+int16_t scoreToTT(int score) {
+  if (score >= MATE_BAND) return static_cast<int16_t>(TT_MATE - (MATE_SCORE - score));
+  if (score <= -MATE_BAND) return static_cast<int16_t>(-TT_MATE + (MATE_SCORE + score));
+  return static_cast<int16_t>(std::clamp(score, -TT_MATE_BAND + 1, TT_MATE_BAND - 1));
+}
+
+int scoreFromTT(int16_t score) {
+  if (score >= TT_MATE_BAND) return MATE_SCORE - (TT_MATE - score);
+  if (score <= -TT_MATE_BAND) return -MATE_SCORE + (TT_MATE + score);
+  return score;
+}
 
-  // round DOWN to nearest power of two, minimum 1
-  size_t pow2 = 1;
-  while (pow2 * 2 <= entries) pow2 *= 2;
-  return pow2;
+uint16_t keyOf(uint64_t hash) { return static_cast<uint16_t>(hash); }
+
+constexpr char TT_FILE_MAGIC[8] = {'I', 'N', 'D', 'U', 'S', 'T', 'T', '\0'};
+constexpr uint32_t TT_FILE_VERSION = 1;
+
+#if defined(__linux__)
+// The active transparent huge page mode, the bracketed word in e.g.
+// "always [madvise] never"; empty if it can't be read.
+std::string thpMode() {
+  std::ifstream in("/sys/kernel/mm/transparent_hugepage/enabled");
+  std::string word;
+  while (in >> word) {
+    if (word.size() > 2 && word.front() == '[' && word.back() == ']') {
+      return word.substr(1, word.size() - 2);
+    }
+  }
+  return "";
+}
+#endif
+
+bool validHeader(const TTFileHeader &header, uint64_t fileBytes, std::string &error) {
+  if (std::memcmp(header.magic, TT_FILE_MAGIC, sizeof(TT_FILE_MAGIC)) != 0) {
+    error = "not a hash file";
+    return false;
+  }
+  if (header.version != TT_FILE_VERSION || header.bucketBytes != sizeof(TTBucket)) {
+    error = "hash file format version " + std::to_string(header.version) + " is not supported";
+    return false;
+  }
+  if (header.megabytes == 0 ||
+      header.bucketCount != header.megabytes * 1024ULL * 1024ULL / sizeof(TTBucket) ||
+      fileBytes != sizeof(TTFileHeader) + header.bucketCount * sizeof(TTBucket)) {
+    error = "hash file is truncated or corrupt";
+    return false;
+  }
+  return true;
 }
 
+}  // namespace
+
 TranspositionTable::TranspositionTable(size_t mb) { resize(mb); }
 
-void TranspositionTable::resize(size_t mb) {
-  size_t entries = entriesForMB(mb);
-  transpositionTable.assign(entries, TTEntry{});
-  sizeMask = entries - 1;
+TranspositionTable::~TranspositionTable() { release(); }
+
+bool TranspositionTable::resize(size_t mb) {
+  if (mb < 1) mb = 1;
+  release();
+
+  bool allocated = true;
+  try {
+    bucketCount = mb * 1024ULL * 1024ULL / sizeof(TTBucket);
+    allocate(bucketCount * sizeof(TTBucket));
+  } catch (const std::bad_alloc &) {
+    allocated = false;
+    try {
+      bucketCount = 16 * 1024ULL * 1024ULL / sizeof(TTBucket);
+      allocate(bucketCount * sizeof(TTBucket));
+    } catch (const std::bad_alloc &) {
+      bucketCount = 0;  // Left empty, on emptyBucket
+    }
+  }
+
+  // Also the first touch of every page: clearing in parallel spreads the
+  // page faults, and on NUMA machines the pages, across the threads.
+  clear_table();
+  return allocated;
+}
+
+/*
+At multi-GB sizes nearly every probe misses the TLB with 4 KB pages. On
+Linux the table is an anonymous mapping trimmed to a 2 MB boundary and
+marked MADV_HUGEPAGE, so transparent huge pages can back it (when THP is
+in "madvise" or "always" mode). Anything else gets a plain cache-line
+aligned allocation.
+*/
+void TranspositionTable::allocate(size_t bytes) {
+#if defined(__linux__)
+  constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+  const size_t mapped = bytes + HUGE_PAGE_SIZE;
+
+  void *raw = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw != MAP_FAILED) {
+    char *start = static_cast<char *>(raw);
+    char *aligned = reinterpret_cast<char *>(
+        (reinterpret_cast<uintptr_t>(start) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+    char *end = start + mapped;
+    char *alignedEnd = aligned + ((bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+    alignedEnd = std::min(alignedEnd, end);
+
+    if (aligned > start) munmap(start, aligned - start);
+    if (end > alignedEnd) munmap(alignedEnd, end - alignedEnd);
+
+    allocBase = aligned;
+    allocBytes = alignedEnd - aligned;
+    allocMapped = true;
+#if defined(MADV_HUGEPAGE)
+    // madvise succeeds even when THP is switched off, and with it on the
+    // kernel still only backs what it can, so this is a request, not a
+    // guarantee.
+    const std::string thp = thpMode();
+    if (madvise(allocBase, allocBytes, MADV_HUGEPAGE) != 0) {
+      allocMode = "mmap, huge pages unavailable";
+    } else if (thp == "never") {
+      allocMode = "mmap, huge pages disabled (THP never)";
+    } else if (thp == "always") {
+      allocMode = "mmap, huge pages requested (THP always)";
+    } else if (thp == "madvise") {
+      allocMode = "mmap, huge pages requested (THP madvise)";
+    } else {
+      allocMode = "mmap, huge pages requested";
+    }
+#else
+    allocMode = "mmap, huge pages unavailable";
+#endif
+  }
+#endif
+
+  if (allocBase == nullptr) {
+    allocBytes = bytes;
+#if defined(_WIN32)
+    allocBase = _aligned_malloc(bytes, alignof(TTBucket));
+#else
+    allocBase = std::aligned_alloc(alignof(TTBucket), bytes);
+#endif
+    if (allocBase == nullptr) throw std::bad_alloc();
+    allocMode = "aligned allocation";
+  }
+
+  buckets = static_cast<TTBucket *>(allocBase);
+  for (size_t i = 0; i < bucketCount; ++i) {
+    new (&buckets[i]) TTBucket;
+  }
+}
+
+void TranspositionTable::release() {
+  if (allocBase == nullptr) return;
+
+#if defined(__linux__)
+  if (allocMapped) {
+    munmap(allocBase, allocBytes);
+  } else {
+    std::free(allocBase);
+  }
+#elif defined(_WIN32)
+  _aligned_free(allocBase);
+#else
+  std::free(allocBase);
+#endif
+
+  allocBase = nullptr;
+  allocBytes = 0;
+  allocMapped = false;
+  buckets = &emptyBucket;
+  bucketCount = 0;
+  allocMode = "none";
+}
+
+void TranspositionTable::clear_table() {
+  // No search runs during a clear, so plain memset is fine on the atomics.
+  constexpr size_t MIN_BYTES_PER_THREAD = 64ULL * 1024 * 1024;
+  const size_t bytes = bucketCount * sizeof(TTBucket);
+  const size_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+  const size_t threads = std::clamp<size_t>(bytes / MIN_BYTES_PER_THREAD, 1, hardwareThreads);
+
+  auto clearRange = [this](size_t first, size_t last) {
+    std::memset(static_cast<void *>(buckets + first), 0, (last - first) * sizeof(TTBucket));
+  };
+
+  if (threads == 1) {
+    clearRange(0, bucketCount);
+  } else {
+    std::vector<std::thread> workers;
+    const size_t chunk = bucketCount / threads;
+    for (size_t t = 0; t < threads; ++t) {
+      const size_t first = t * chunk;
+      const size_t last = t + 1 == threads ? bucketCount : first + chunk;
+      workers.emplace_back(clearRange, first, last);
+    }
+    for (auto &worker : workers) worker.join();
+  }
+  std::memset(static_cast<void *>(&emptyBucket), 0, sizeof(TTBucket));
+
+  generation = 0;
+  ttProbes = 0;
   ttHits = 0;
   ttStores = 0;
 }
 
-void TranspositionTable::printTTStats() const {
-  std::cout << "Transposition Table Stats:\n";
-  std::cout << "  TT Hits       : " << ttHits << "\n";
-  std::cout << "  TT Stores     : " << ttStores << "\n";
-  std::cout << "  TT Size       : " << transpositionTable.size() << " entries\n";
+bool TranspositionTable::save(const std::string &path, std::string &error) const {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    error = "cannot open " + path;
+    return false;
+  }
+
+  TTFileHeader header{};
+  std::memcpy(header.magic, TT_FILE_MAGIC, sizeof(TT_FILE_MAGIC));
+  header.version = TT_FILE_VERSION;
+  header.bucketBytes = sizeof(TTBucket);
+  header.megabytes = sizeMB();
+  header.bucketCount = bucketCount;
+  header.generation = generation;
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  constexpr size_t CHUNK_BYTES = 64ULL * 1024 * 1024;
+  const char *data = reinterpret_cast<const char *>(buckets);
+  size_t remaining = bucketCount * sizeof(TTBucket);
+  while (remaining > 0 && out) {
+    const size_t n = std::min(remaining, CHUNK_BYTES);
+    out.write(data, static_cast<std::streamsize>(n));
+    data += n;
+    remaining -= n;
+  }
+
+  out.close();
+  if (!out) {
+    error = "write to " + path + " failed";
+    return false;
+  }
+  return true;
 }
 
-bool TranspositionTable::probeTT(uint64_t hash, int depth, int &score,
-                                 int alpha, int beta, chess::Move &bestMove,
-                                 int ply) {
-  const size_t index = hash & sizeMask;
-  const TTEntry &entry = transpositionTable[index];
+/*
+The file is validated from its header alone, then the buckets are copied
+in one pass. On Linux that pass reads straight from a read-only mapping,
+so the load runs at disk (or page cache) speed with no parsing and no
+intermediate buffer.
+*/
+bool TranspositionTable::load(const std::string &path, std::string &error) {
+#if defined(__linux__)
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    error = "cannot open " + path;
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(TTFileHeader)) {
+    close(fd);
+    error = "hash file is truncated or corrupt";
+    return false;
+  }
+
+  const size_t fileBytes = static_cast<size_t>(info.st_size);
+  void *mapped = mmap(nullptr, fileBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    error = "cannot map " + path;
+    return false;
+  }
+  madvise(mapped, fileBytes, MADV_SEQUENTIAL);
+
+  TTFileHeader header;
+  std::memcpy(&header, mapped, sizeof(header));
+  if (!validHeader(header, fileBytes, error)) {
+    munmap(mapped, fileBytes);
+    return false;
+  }
+
+  if (header.bucketCount != bucketCount && !resize(header.megabytes)) {
+    munmap(mapped, fileBytes);
+    error = "cannot allocate " + std::to_string(header.megabytes) + " MB";
+    return false;
+  }
+
+  std::memcpy(static_cast<void *>(buckets),
+              static_cast<const char *>(mapped) + sizeof(TTFileHeader),
+              bucketCount * sizeof(TTBucket));
+  munmap(mapped, fileBytes);
+#else
+  std::ifstream in(path, std::ios::binary | std::ios::ate);
+  if (!in) {
+    error = "cannot open " + path;
+    return false;
+  }
 
-  if (entry.hash != hash) {
+  const uint64_t fileBytes = static_cast<uint64_t>(in.tellg());
+  in.seekg(0);
+  TTFileHeader header{};
+  if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      !validHeader(header, fileBytes, error)) {
+    if (error.empty()) error = "hash file is truncated or corrupt";
     return false;
   }
 
-  ttHits++;
-  bestMove = entry.bestMove;
+  if (header.bucketCount != bucketCount && !resize(header.megabytes)) {
+    error = "cannot allocate " + std::to_string(header.megabytes) + " MB";
+    return false;
+  }
 
-  if (entry.depth >= depth) {
-    int tt_score = entry.score;
-    if (std::abs(tt_score) >= MATE_SCORE - MATE_THRESHHOLD) {
-      tt_score += (tt_score > 0 ? -ply : ply);  // Adjust for current ply
+  if (!in.read(reinterpret_cast<char *>(buckets),
+               static_cast<std::streamsize>(bucketCount * sizeof(TTBucket)))) {
+    clear_table();
+    error = "read from " + path + " failed";
+    return false;
+  }
+#endif
+
+  generation = header.generation;
+  ttProbes = 0;
+  ttHits = 0;
+  ttStores = 0;
+  return true;
+}
+
+int TranspositionTable::hashfull() const {
+  constexpr size_t SAMPLE_BUCKETS = 1000 / TTBucket::SIZE;
+
+  const size_t sampled = std::min(SAMPLE_BUCKETS, bucketCount);
+  int used = 0;
+  for (size_t i = 0; i < sampled; ++i) {
+    for (const auto &slot : buckets[i].entries) {
+      const TTEntry entry = TTEntry::unpack(slot.load(std::memory_order_relaxed));
+      if (!entry.empty() && age(entry) == 0) used++;
     }
+  }
+  return sampled > 0 ? static_cast<int>(used * 1000 / (sampled * TTBucket::SIZE)) : 0;
+}
+
+void TranspositionTable::printTTStats(std::ostream &out) const {
+  const size_t entries = bucketCount * TTBucket::SIZE;
+  const size_t megabytes = sizeMB();
+  const long long probes = ttProbes, hits = ttHits;
+
+  out << "Transposition Table Stats:\n";
+#ifdef INDUS_SEARCH_STATS
+  out << "  TT Probes     : " << probes << "\n";
+  out << "  TT Hits       : " << hits << "\n";
+  if (probes > 0) {
+    out << "  TT Hit Rate   : " << 100.0 * hits / probes << "%\n";
+  }
+  out << "  TT Stores     : " << ttStores << "\n";
+#else
+  (void)probes;
+  (void)hits;
+  out << "  TT Probes/Hits/Stores: not counted, rebuild with "
+               "-DINDUS_ENABLE_SEARCH_STATS=ON\n";
+#endif
+  out << "  TT Size       : " << entries << " entries ("
+            << (megabytes ? entries / megabytes : entries) << " per MB)\n";
+  out << "  TT Memory     : " << allocMode << "\n";
 
-    if (entry.type == TTEntryType::EXACT) {
-      score = tt_score;
-      return true;
+  // Occupancy from a scan of (at most) the first 8M entries.
+  constexpr size_t MAX_SCAN_BUCKETS = 1 << 20;
+  const size_t scanned = std::min(MAX_SCAN_BUCKETS, bucketCount);
+
+  long long current = 0, older = 0;
+  long long byBound[3] = {};
+  long long byDepth[256] = {};
+  for (size_t i = 0; i < scanned; ++i) {
+    for (const auto &slot : buckets[i].entries) {
+      const TTEntry entry = TTEntry::unpack(slot.load(std::memory_order_relaxed));
+      if (entry.empty()) continue;
+      (age(entry) == 0 ? current : older)++;
+      byBound[static_cast<int>(entry.type())]++;
+      byDepth[entry.depth]++;
     }
-    if (entry.type == TTEntryType::LOWER && tt_score >= beta) {
-      score = tt_score;
-      return true;
+  }
+
+  const double total = static_cast<double>(scanned * TTBucket::SIZE);
+  out << "  Occupancy     : " << 100.0 * (current + older) / total << "% ("
+            << 100.0 * current / total << "% this search, " << 100.0 * older / total
+            << "% older), " << scanned * TTBucket::SIZE << " entries scanned\n";
+  out << "  By bound      : exact " << byBound[0] << " lower " << byBound[1]
+            << " upper " << byBound[2] << "\n";
+  out << "  By depth      :";
+  for (int d = 0; d < 256; ++d) {
+    if (byDepth[d] > 0) out << " " << d << ":" << byDepth[d];
+  }
+  out << "\n";
+}
+
+bool TranspositionTable::probeTT(uint64_t hash, int depth, int &score,
+                                 int alpha, int beta, chess::Move &bestMove,
+                                 int ply) {
+  bump(ttProbes);
+
+  const uint16_t key = keyOf(hash);
+  const TTBucket &bucket = bucketFor(hash);
+
+  for (const auto &slot : bucket.entries) {
+    const TTEntry entry = TTEntry::unpack(slot.load(std::memory_order_relaxed));
+    if (entry.key != key || entry.empty()) {
+      continue;
     }
-    if (entry.type == TTEntryType::UPPER && tt_score <= alpha) {
-      score = tt_score;
-      return true;
+
+    bump(ttHits);
+    bestMove = chess::Move(entry.move);
+
+    if (entry.depth >= depth) {
+      int tt_score = scoreFromTT(entry.score);
+      if (std::abs(tt_score) >= MATE_SCORE - MATE_THRESHHOLD) {
+        tt_score += (tt_score > 0 ? -ply : ply);  // Adjust for current ply
+      }
+
+      const TTEntryType type = entry.type();
+      if (type == TTEntryType::EXACT) {
+        score = tt_score;
+        return true;
+      }
+      if (type == TTEntryType::LOWER && tt_score >= beta) {
+        score = tt_score;
+        return true;
+      }
+      if (type == TTEntryType::UPPER && tt_score <= alpha) {
+        score = tt_score;
+        return true;
+      }
     }
+
+    return false;
   }
 
   return false;
 }
 
+chess::Move TranspositionTable::probeMove(uint64_t hash) {
+  const uint16_t key = keyOf(hash);
+  for (const auto &slot : bucketFor(hash).entries) {
+    const TTEntry entry = TTEntry::unpack(slot.load(std::memory_order_relaxed));
+    if (entry.key == key && !entry.empty()) return chess::Move(entry.move);
+  }
+  return chess::Move::NULL_MOVE;
+}
+
 void TranspositionTable::storeTT(uint64_t hash, int depth, int score,
                                  TTEntryType type, chess::Move bestMove,
                                  int ply) {
@@ -73,20 +472,48 @@ void TranspositionTable::storeTT(uint64_t hash, int depth, int score,
     score += (score > 0 ? ply : -ply);  // Adjust to ply 0
   }
 
-  const size_t index = hash & sizeMask;
-  TTEntry &entry = transpositionTable[index];
+  const uint16_t key = keyOf(hash);
+  TTBucket &bucket = bucketFor(hash);
 
-  // Replacement policy: always take an empty/different-position slot,
-  // otherwise only overwrite if the new search was at least as deep,
-  // or if the new entry is EXACT (more informative than a bound)
-  // replacing a non-EXACT entry at the same or shallower depth.
-  const bool differentPosition = entry.hash != hash;
-  const bool deeperOrEqual = depth >= entry.depth;
-  const bool upgradingToExact =
-      type == TTEntryType::EXACT && entry.type != TTEntryType::EXACT;
+  // Reuse this position's slot if it has one; otherwise take an empty slot,
+  // or evict the entry that is oldest and shallowest.
+  // Another thread may store into the same bucket meanwhile; the worst
+  // outcome is that one of the two stores is lost, never a mixed entry.
+  std::atomic<uint64_t> *slot = &bucket.entries[0];
+  TTEntry old = TTEntry::unpack(slot->load(std::memory_order_relaxed));
+  for (auto &candidate : bucket.entries) {
+    const TTEntry entry = TTEntry::unpack(candidate.load(std::memory_order_relaxed));
+    if (!entry.empty() && entry.key == key) {
+      slot = &candidate;
+      old = entry;
+      break;
+    }
+    if (replaceValue(entry) < replaceValue(old)) {
+      slot = &candidate;
+      old = entry;
+    }
+  }
 
-  if (differentPosition || deeperOrEqual || upgradingToExact) {
-    entry = {hash, score, depth, type, bestMove};
-    ttStores++;
+  // Same position: only overwrite if the entry is from an older search, if
+  // the new search was at least as deep, or if the new entry is EXACT (more
+  // informative than a bound) replacing a non-EXACT entry.
+  if (!old.empty() && old.key == key) {
+    const bool stale = age(old) != 0;
+    const bool deeperOrEqual = depth >= old.depth;
+    const bool upgradingToExact =
+        type == TTEntryType::EXACT && old.type() != TTEntryType::EXACT;
+    if (!stale && !deeperOrEqual && !upgradingToExact) {
+      return;
+    }
   }
-}
\ No newline at end of file
+
+  TTEntry entry;
+  entry.key = key;
+  entry.move = bestMove.move();
+  entry.score = scoreToTT(score);
+  entry.depth = static_cast<uint8_t>(std::clamp(depth, 0, 255));
+  entry.genBound = static_cast<uint8_t>((generation << TTEntry::GENERATION_SHIFT) |
+                                        (static_cast<int>(type) + 1));
+  slot->store(entry.pack(), std::memory_order_relaxed);
+  bump(ttStores);
+}
@@ -1,6 +1,14 @@
 #pragma once
 
-#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#if defined(_MSC_VER)
+#include <xmmintrin.h>
+#endif
 
 #include "chess.hpp"
 
@@ -11,23 +19,85 @@ enum class TTEntryType {
   UPPER   // Upper bound (beta cutoff)
 };
 
-// Structure for transposition table entries
+// One packed 8-byte entry. Only the low 16 bits of the hash are kept; the
+// bucket index comes from the high bits. A false match returns another
+// position's move and score. The move is checked for legality by the move
+// picker, but the score is trusted: negamax can take a cutoff on it and
+// return a wrong value. With 16 key bits plus the index that's rare
+// enough to accept, not impossible.
+//
+// In the table an entry lives as a single 64-bit atomic word, so threads
+// sharing the table always read and write whole entries: a probe can never
+// see the key of one store with the move or score of another.
 struct TTEntry {
-  uint64_t hash;         // Zobrist hash of the position
-  int score;             // Evaluation score
-  int depth;             // Depth at which the position was evaluated
-  TTEntryType type;      // Type of entry
-  chess::Move bestMove;  // Best move found for this position
+  uint16_t key;       // Low 16 bits of the Zobrist hash
+  uint16_t move;      // chess::Move::move()
+  int16_t score;      // Mate scores remapped into 16 bits, see tt.cpp
+  uint8_t depth;      // Depth at which the position was evaluated
+  uint8_t genBound;   // Generation in the high 6 bits, bound in the low 2
+
+  // Bound 0 is never stored, so an all-zero entry is an empty slot.
+  bool empty() const { return (genBound & BOUND_MASK) == 0; }
+  TTEntryType type() const { return static_cast<TTEntryType>((genBound & BOUND_MASK) - 1); }
+  uint8_t generation() const { return genBound >> GENERATION_SHIFT; }
+
+  uint64_t pack() const {
+    return uint64_t(key) | uint64_t(move) << 16 | uint64_t(uint16_t(score)) << 32 |
+           uint64_t(depth) << 48 | uint64_t(genBound) << 56;
+  }
+
+  static TTEntry unpack(uint64_t data) {
+    return {static_cast<uint16_t>(data), static_cast<uint16_t>(data >> 16),
+            static_cast<int16_t>(data >> 32), static_cast<uint8_t>(data >> 48),
+            static_cast<uint8_t>(data >> 56)};
+  }
+
+  static constexpr uint8_t BOUND_MASK = 0x3;
+  static constexpr int GENERATION_SHIFT = 2;
+  static constexpr uint8_t GENERATION_CYCLE = 64;  // 6 bits
+};
+
+static_assert(sizeof(TTEntry) == 8, "TTEntry must pack into 8 bytes");
+
+// A cache line of entries. A probe touches exactly one line.
+struct alignas(64) TTBucket {
+  static constexpr int SIZE = 8;
+  std::atomic<uint64_t> entries[SIZE];
 };
 
+static_assert(sizeof(TTBucket) == 64, "TTBucket must be one cache line");
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "the TT relies on lock-free 64-bit atomics");
+
+struct TTFileHeader {
+  char magic[8];         // "INDUSTT\0"
+  uint32_t version;      // TT_FILE_VERSION, bumped whenever TTEntry changes
+  uint32_t bucketBytes;  // sizeof(TTBucket)
+  uint64_t megabytes;    // Hash size the table was created with
+  uint64_t bucketCount;
+  uint8_t generation;
+  uint8_t reserved[31];
+};
+
+static_assert(sizeof(TTFileHeader) == 64, "TT files start with a 64-byte header");
+
+// Safe to share between search threads without locks. Entries are read and
+// written with relaxed atomics (plain moves on x86-64).
+
 class TranspositionTable {
  public:
   explicit TranspositionTable(size_t mb = 16);  // default 16 MB
+  ~TranspositionTable();
+
+  TranspositionTable(const TranspositionTable &) = delete;
+  TranspositionTable &operator=(const TranspositionTable &) = delete;
 
-  // Resize the table to hold roughly `mb` megabytes. Always rounds down to
-  // a power-of-two entry count so the `hash & sizeMask` trick keeps working.
+  // Resize the table to hold roughly `mb` megabytes of buckets. Any bucket
+  // count works since the index is a multiply-high, not a mask.
   // Wipes all existing entries (unavoidable — the index scheme changes).
-  void resize(size_t mb);
+  // Returns false if the memory couldn't be had; the table then falls
+  // back to the default 16 MB, or is left empty if even that fails.
+  bool resize(size_t mb);
 
   void storeTT(uint64_t hash, int depth, int score, TTEntryType type,
                chess::Move bestMove, int ply);
@@ -35,22 +105,110 @@ class TranspositionTable {
   bool probeTT(uint64_t hash, int depth, int &score, int alpha, int beta,
                chess::Move &bestMove, int ply);
 
-  void clear_table() {
-    for (auto &entry : transpositionTable) {
-      entry = TTEntry{};
-    }
-    ttHits = 0;
-    ttStores = 0;
+  // Just the stored move for `hash`, whatever its depth or bound, or
+  // NULL_MOVE. Not counted in the probe statistics.
+  chess::Move probeMove(uint64_t hash);
+
+  // Ages every entry by one generation in O(1): entries written before
+  // the call stay probe-able but become the first to be replaced. Called
+  // at the start of each search and on ucinewgame.
+  void newSearch() { generation = (generation + 1) % TTEntry::GENERATION_CYCLE; }
+
+  // A real wipe, linear in the table size. Only for an explicit request
+  // (Clear Hash) and for runs that must start cold, like bench. Large
+  // tables are cleared by all hardware threads at once.
+  void clear_table();
+
+  // Start loading the bucket for `hash` into cache. Issued before makeMove
+  // so the child's probe doesn't stall on a DRAM miss.
+  void prefetch(uint64_t hash) const {
+    const TTBucket *bucket = &buckets[mulhi64(hash, bucketCount)];
+#if defined(_MSC_VER)
+    _mm_prefetch(reinterpret_cast<const char *>(bucket), _MM_HINT_T0);
+#else
+    __builtin_prefetch(bucket);
+#endif
   }
 
+  // Binary snapshot of the table: a TTFileHeader followed by the raw
+  // buckets, in native byte order. load() maps the file and copies it in,
+  // resizing the table to the saved size if needed. On failure `error`
+  // says why; a file that fails validation leaves the table untouched.
+  bool save(const std::string &path, std::string &error) const;
+  bool load(const std::string &path, std::string &error);
+
+  // Permille of the first 1000 entries written by the current search, for
+  // the UCI hashfull field. Cheap enough for every info line.
+  int hashfull() const;
+
   // Table Stats
-  void printTTStats() const;
+  void printTTStats(std::ostream &out) const;
+
+  // How the current table memory was obtained, e.g. for an info string.
+  const char *allocationMode() const { return allocMode; }
+  size_t sizeMB() const { return bucketCount * sizeof(TTBucket) / (1024 * 1024); }
 
  private:
-  std::vector<TTEntry> transpositionTable;
-  size_t sizeMask = 0;  // entries - 1, entries is always a power of two
-  int ttHits = 0;       // Number of search matches
-  int ttStores = 0;     // Total stores
+  // An empty table (bucketCount 0) points `buckets` here, so probes and
+  // stores need no check: every hash indexes bucket 0 of a zero-sized
+  // table, and this one bucket takes them.
+  TTBucket emptyBucket{};
+  TTBucket *buckets = &emptyBucket;
+  size_t bucketCount = 0;
+
+  // The whole mapping/allocation behind `buckets`, released as a unit.
+  void *allocBase = nullptr;
+  size_t allocBytes = 0;
+  bool allocMapped = false;
+  const char *allocMode = "none";
+
+  void allocate(size_t bytes);
+  void release();
+
+  // Only changed between searches, never while threads are probing.
+  uint8_t generation = 0;
+
+  // Only counted in INDUS_SEARCH_STATS builds, like the STAT_* counters:
+  // every thread bumping them on every probe would make them one cache
+  // line all Lazy SMP threads fight over.
+  std::atomic<long long> ttProbes{0};  // Number of probes
+  std::atomic<long long> ttHits{0};    // Number of search matches
+  std::atomic<long long> ttStores{0};  // Total stores
+
+  static void bump(std::atomic<long long> &counter) {
+#ifdef INDUS_SEARCH_STATS
+    counter.fetch_add(1, std::memory_order_relaxed);
+#else
+    (void)counter;
+#endif
+  }
+
+  // Searches since the entry was written, modulo the generation cycle.
+  int age(const TTEntry &entry) const {
+    return (TTEntry::GENERATION_CYCLE + generation - entry.generation()) %
+           TTEntry::GENERATION_CYCLE;
+  }
+
+  // How much an entry is worth keeping; the lowest in a bucket is evicted.
+  // Each search of age costs as much as 8 plies of depth.
+  int replaceValue(const TTEntry &entry) const {
+    return entry.empty() ? -1000 : entry.depth - 8 * age(entry);
+  }
 
-  static size_t entriesForMB(size_t mb);
-};
\ No newline at end of file
+  TTBucket &bucketFor(uint64_t hash) {
+    return buckets[mulhi64(hash, bucketCount)];
+  }
+
+  // Maps a 64-bit hash uniformly onto [0, n) using its high bits.
+  static uint64_t mulhi64(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(a) * b) >> 64);
+#else
+    const uint64_t aLo = a & 0xFFFFFFFFULL, aHi = a >> 32;
+    const uint64_t bLo = b & 0xFFFFFFFFULL, bHi = b >> 32;
+    const uint64_t mid = aHi * bLo + ((aLo * bLo) >> 32);
+    const uint64_t mid2 = aLo * bHi + (mid & 0xFFFFFFFFULL);
+    return aHi * bHi + (mid >> 32) + (mid2 >> 32);
+#endif
+  }
+};
@@ -1,5 +1,18 @@
 #pragma once
 
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// The search thread and the UCI input thread both write to the GUI. Every
+// line goes out under one lock so neither can split the other's output.
+inline void sendLine(const std::string &line) {
+  static std::mutex outputMutex;
+  std::lock_guard<std::mutex> lock(outputMutex);
+  std::cout << line << std::endl;
+}
+
 struct GoOptions {
   long long wtime = 0;
   long long btime = 0;
@@ -8,8 +21,14 @@ struct GoOptions {
   long long movestogo = 0;
   long long movetime = 0;
   bool infinite = false;
+  bool ponder = false;
   int depth = 0;
 
+  // Node budgets; 0 means none. `nodes` is the UCI hard limit. softNodes is
+  // only set by datagen: no new iteration starts once it has been reached.
+  long long nodes = 0;
+  long long softNodes = 0;
+
   bool hasTimeLimit() const {
     return !infinite && (wtime > 0 || btime > 0 || movetime > 0);
   }
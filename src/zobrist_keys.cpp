@@ -0,0 +1,68 @@
+#include "zobrist_keys.hpp"
+
+#include <string>
+
+namespace {
+
+uint64_t hashOf(const std::string &fen) { return chess::Board(fen).hash(); }
+
+// Rank 8 first, one char per square ('1' for empty): setFen reads each
+// digit as a run of one.
+std::string placement(const std::string &squares) {
+  std::string out;
+  for (int rank = 7; rank >= 0; --rank) {
+    out += squares.substr(rank * 8, 8);
+    if (rank > 0) out += '/';
+  }
+  return out;
+}
+
+}  // namespace
+
+namespace ZobristKeys {
+
+Tables build() {
+  Tables t{};
+  const std::string empty(64, '1');
+  const uint64_t emptyHash = hashOf(placement(empty) + " b - - 0 1");
+
+  t.sideToMove = hashOf(placement(empty) + " w - - 0 1") ^ emptyHash;
+
+  for (int p = 0; p < 12; ++p) {
+    const char symbol = static_cast<std::string>(chess::Piece(static_cast<chess::Piece::underlying>(p)))[0];
+    for (int sq = 0; sq < 64; ++sq) {
+      std::string squares = empty;
+      squares[sq] = symbol;
+      t.piece[p][sq] = hashOf(placement(squares) + " b - - 0 1") ^ emptyHash;
+    }
+  }
+
+  // White to move with a pawn beside the black pawn that just double pushed,
+  // so setFen keeps the square; kings on a1/a8 so the capture is legal.
+  for (int file = 0; file < 8; ++file) {
+    std::string squares = empty;
+    squares[0] = 'K';
+    squares[56] = 'k';
+    squares[32 + file] = 'p';
+    squares[32 + (file == 0 ? 1 : file - 1)] = 'P';
+    const std::string position = placement(squares) + " w - ";
+    const std::string epSquare(1, static_cast<char>('a' + file));
+    t.enpassant[file] = hashOf(position + epSquare + "6 0 1") ^ hashOf(position + "- 0 1");
+  }
+
+  // Index by the rights the board actually parsed, not by the FEN letters.
+  const std::string corners = "r3k2r/8/8/8/8/8/8/R3K2R b ";
+  const uint64_t noRights = hashOf(corners + "- - 0 1");
+  for (int mask = 1; mask < 16; ++mask) {
+    std::string rights;
+    for (int i = 0; i < 4; ++i) {
+      if (mask & (1 << i)) rights += "KQkq"[i];
+    }
+    const chess::Board board(corners + rights + " - 0 1");
+    t.castling[board.castlingRights().hashIndex()] = board.hash() ^ noRights;
+  }
+
+  return t;
+}
+
+}  // namespace ZobristKeys
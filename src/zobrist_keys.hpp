@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+#include "chess.hpp"
+
+/*
+The Zobrist keys chess::Board hashes with, for working out a key without
+making the move (Search::keyAfter). The library keeps its key table private
+to Board, so the keys are read back once through its public hash(): each one
+is the difference between the hashes of two positions that differ only in
+that piece, right or flag. chess.hpp stays as vendored.
+*/
+namespace ZobristKeys {
+
+struct Tables {
+  uint64_t piece[12][64];
+  uint64_t enpassant[8];   // By file
+  uint64_t castling[16];   // By CastlingRights::hashIndex()
+  uint64_t sideToMove;     // Present when white is to move
+};
+
+Tables build();
+
+// Built on first use; every accessor goes through here.
+inline const Tables &tables() {
+  static const Tables t = build();
+  return t;
+}
+
+inline uint64_t piece(chess::Piece piece, chess::Square sq) {
+  return tables().piece[int(piece)][sq.index()];
+}
+
+inline uint64_t enpassant(chess::File file) { return tables().enpassant[int(file)]; }
+
+inline uint64_t castling(int hashIndex) { return tables().castling[hashIndex]; }
+
+// One right, as numbered by CastlingRights::clear(color, side).
+inline uint64_t castlingIndex(int index) { return tables().castling[1 << index]; }
+
+inline uint64_t sideToMove() { return tables().sideToMove; }
+
+}  // namespace ZobristKeys
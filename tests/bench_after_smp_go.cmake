@@ -0,0 +1,44 @@
+# `bench` after a multi-threaded `go` has to search exactly like `bench`
+# in a fresh engine. The helpers' node counts from the `go` used to count
+# against the bench node budget, stopping every position at node 0.
+#
+# Run by ctest: cmake -DENGINE=<path to indus-dragon> -P bench_after_smp_go.cmake
+
+if(NOT ENGINE)
+  message(FATAL_ERROR "ENGINE is not set")
+endif()
+
+set(BENCH "bench nodes 50000")
+
+# Prints the per-position "nodes N score S bestmove M" lines of one run.
+function(run_engine name commands result)
+  set(input "${CMAKE_CURRENT_BINARY_DIR}/${name}.in")
+  string(REPLACE ";" "\n" text "${commands}")
+  file(WRITE "${input}" "${text}\nquit\n")
+
+  execute_process(
+    COMMAND "${ENGINE}"
+    INPUT_FILE "${input}"
+    OUTPUT_VARIABLE output
+    RESULT_VARIABLE status
+    TIMEOUT 300)
+  if(NOT status EQUAL 0)
+    message(FATAL_ERROR "${name}: engine exited with ${status}\n${output}")
+  endif()
+
+  string(REGEX MATCHALL "nodes [0-9]+ score [^\n]*" lines "${output}")
+  if(NOT lines)
+    message(FATAL_ERROR "${name}: no bench output\n${output}")
+  endif()
+  set(${result} "${lines}" PARENT_SCOPE)
+endfunction()
+
+run_engine(fresh "${BENCH}" expected)
+run_engine(after_smp_go
+  "setoption name Threads value 2;go depth 11;${BENCH}" actual)
+
+if(NOT actual STREQUAL expected)
+  string(REPLACE ";" "\n" expected "${expected}")
+  string(REPLACE ";" "\n" actual "${actual}")
+  message(FATAL_ERROR "bench after an SMP go differs\nexpected:\n${expected}\nactual:\n${actual}")
+endif()